@@ -0,0 +1,147 @@
+/*
+  ________________________
+ /\                       \
+ \_|     I/O BENCHMARK    |
+   |                      |
+   |      bench_io.cc     |
+   |   ___________________|_
+    \_/_____________________/
+*/
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <stdio.h>
+#include <sys/stat.h>
+#include "instance.h"
+#include "synthetic.h"
+using namespace std;
+
+// Function that reads an instance with the stream operator, one number at
+// a time, as the solvers used to do.
+instance stream_instance(const string& path) {
+  ifstream in(path);
+  instance inst;
+  in >> inst.cars >> inst.improvements >> inst.classes;
+  inst.resources.resize(inst.improvements);
+  for (int i = 0; i < inst.improvements; ++i) in >> inst.resources[i].first;
+  for (int i = 0; i < inst.improvements; ++i) in >> inst.resources[i].second;
+  inst.models.resize(inst.classes);
+  inst.mask_words = (inst.improvements + 63) / 64;
+  inst.masks.assign(inst.classes * inst.mask_words, 0);
+  int group, upgrade;
+  for (int i = 0; i < inst.classes; ++i) {
+    in >> group;
+    car_model& model = inst.models[group];
+    model.model = group;
+    in >> model.num_cars;
+    for (int j = 0; j < inst.improvements; ++j) {
+      in >> upgrade;
+      if (upgrade) {
+        ++model.num_upgrades;
+        inst.masks[group * inst.mask_words + (j >> 6)] |= uint64_t(1) << (j & 63);
+      }
+  } }
+  return inst;
+}
+
+// Function that writes a solution with the stream operator, one car at a
+// time, as the solvers used to do.
+void stream_solution(int penalty, double seconds, const vector<int>& solution,
+    const string& path) {
+  ofstream out(path);
+  out.setf(ios::fixed); out.precision(1);
+  out << penalty << ' ' << seconds << '\n';
+  for (int i = 0; i < int(solution.size()); ++i)
+    (i == 0) ? out << solution[i] : out << ' ' << solution[i];
+  out << '\n';
+}
+
+// Function that runs 'task' three times and returns its best time in seconds.
+template <typename F>
+double best_time(F task) {
+  double best = 1e300;
+  for (int rep = 0; rep < 3; ++rep) {
+    wall_clock::time_point start = wall_clock::now();
+    task();
+    best = min(best, seconds_since(start));
+  }
+  return best;
+}
+
+// Function that returns the size of a file 'path' in megabytes.
+double megabytes(const string& path) {
+  struct stat info;
+  return (stat(path.c_str(), &info) == 0) ? info.st_size / 1e6 : 0;
+}
+
+// Function that tells whether two instances are the same.
+bool same_instance(const instance& a, const instance& b) {
+  if (a.cars != b.cars || a.improvements != b.improvements || a.classes != b.classes
+      || a.resources != b.resources || a.masks != b.masks) return false;
+  for (int c = 0; c < a.classes; ++c)
+    if (a.models[c].num_cars != b.models[c].num_cars) return false;
+  return true;
+}
+
+int main(int argc, char** argv) {
+  // We read the directory for the files of the benchmark, '/tmp' by default.
+  string dir = (argc > 1) ? argv[1] : "/tmp";
+  string instance_path = dir + "/bench_io_instance.txt";
+  string solution_path = dir + "/bench_io_solution.txt";
+  mt19937 rng(2018);
+  bool ok = true;
+
+  // We time loading instances with many classes and stations.
+  printf("%-12s %8s %8s %10s %10s %8s\n", "load", "classes", "MB", "stream MB/s", "mmap MB/s", "speedup");
+  for (int classes = 10000; classes <= 100000; classes *= 10) {
+    instance_shape shape;
+    shape.cars = classes * 10;
+    shape.improvements = 100;
+    shape.classes = classes;
+    instance inst = generate_instance(shape, rng);
+    write_instance(inst, instance_path);
+    double size = megabytes(instance_path);
+    instance streamed, mapped;
+    double t_stream = best_time([&]() { streamed = stream_instance(instance_path); });
+    double t_mapped = best_time([&]() { mapped = read_instance(instance_path); });
+    printf("%-12s %8d %8.1f %10.1f %10.1f %7.1fx\n", "", classes, size,
+        size / t_stream, size / t_mapped, t_stream / t_mapped);
+    if (!same_instance(streamed, mapped) || !same_instance(inst, mapped)) {
+      printf("MISMATCH loading %d classes\n", classes);
+      ok = false;
+    }
+  }
+
+  // We time writing solutions of up to ten million cars.
+  printf("%-12s %8s %8s %10s %10s %8s\n", "write", "cars", "MB", "stream MB/s", "single MB/s", "speedup");
+  for (int cars = 100000; cars <= 10000000; cars *= 10) {
+    instance_shape shape;
+    shape.cars = cars;
+    shape.improvements = 1;
+    shape.classes = 1000;
+    instance inst = generate_instance(shape, rng);
+    vector<int> solution = random_sequence(inst, rng);
+    double t_stream = best_time([&]() { stream_solution(0, 0, solution, solution_path); });
+    string streamed = format_solution(0, 0, solution);
+    double t_single = best_time([&]() { write_solution(0, 0, solution, solution_path); });
+    double size = megabytes(solution_path);
+    printf("%-12s %8d %8.1f %10.1f %10.1f %7.1fx\n", "", cars, size,
+        size / t_stream, size / t_single, t_stream / t_single);
+    // We check that both ways write the same text.
+    stream_solution(0, 0, solution, solution_path + ".stream");
+    ifstream in(solution_path + ".stream");
+    string text((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    if (text != streamed) {
+      printf("MISMATCH writing %d cars\n", cars);
+      ok = false;
+    }
+    remove((solution_path + ".stream").c_str());
+  }
+
+  remove(instance_path.c_str());
+  remove(solution_path.c_str());
+  return ok ? 0 : 1;
+}
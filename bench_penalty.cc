@@ -0,0 +1,115 @@
+/*
+  ________________________
+ /\                       \
+ \_|   PENALTY BENCHMARK  |
+   |                      |
+   |    bench_penalty.cc  |
+   |   ___________________|_
+    \_/_____________________/
+*/
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <random>
+#include <chrono>
+#include <stdio.h>
+#include <dirent.h>
+#include "instance.h"
+#include "penalty.h"
+#include "synthetic.h"
+using namespace std;
+
+// Function that runs 'evaluate' until at least 0.2 seconds have passed and
+// returns the mean time of a call in microseconds. Its last result is kept
+// in 'penalty'.
+template <typename F>
+double time_it(F evaluate, int& penalty) {
+  typedef chrono::steady_clock clock;
+  clock::time_point start = clock::now();
+  double elapsed = 0;
+  int reps = 0;
+  do {
+    penalty = evaluate();
+    ++reps;
+    elapsed = chrono::duration<double, micro>(clock::now() - start).count();
+  } while (elapsed < 2e5 || reps < 3);
+  return elapsed / reps;
+}
+
+// Function that times the four ways to score a complete sequence of an
+// instance named 'name' and prints a row of the table. Returns false if
+// they do not agree on the penalty.
+bool bench(const string& name, const instance& inst, mt19937& rng) {
+  vector<int> solution = random_sequence(inst, rng);
+  int n = solution.size();
+  sequence_bits bits;
+  sequence_scratch scratch;
+  int reference, kernels, scalar, vectorized;
+
+  // We time the generic 'station_penalties' called for every index, as the
+  // solvers used to do, and 'penalties' with the kernels of the windows. The
+  // bits are filled once, as the solvers set them up once per search.
+  fill_bits(bits, solution, inst);
+  double t_ref = time_it([&]() {
+    int penalty = 0;
+    for (int k = 0; k < n; ++k) penalty = station_penalties(bits, k, penalty, inst);
+    return penalty;
+  }, reference);
+  double t_kernels = time_it([&]() {
+    int penalty = 0;
+    for (int k = 0; k < n; ++k) penalty = penalties(bits, k, penalty, inst);
+    return penalty;
+  }, kernels);
+  // We time the full-sequence evaluator with and without AVX2.
+  double t_scalar = time_it([&]() {
+    return sequence_penalty(solution, inst, scratch, false);
+  }, scalar);
+  double t_vector = time_it([&]() {
+    return sequence_penalty(solution, inst, scratch, true);
+  }, vectorized);
+
+  printf("%-24s %8d %4d %12.2f %12.2f %12.2f %12.2f %8.1fx %8.1fx %8.1fx\n", name.c_str(),
+      n, inst.improvements, t_ref, t_kernels, t_scalar, t_vector, t_ref / t_kernels,
+      t_ref / t_scalar, t_ref / t_vector);
+  if (reference != kernels || reference != scalar || reference != vectorized) {
+    printf("MISMATCH %s: %d %d %d %d\n", name.c_str(), reference, kernels, scalar, vectorized);
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  // We read the directory of the benchs, which is 'public_benchs' by default.
+  string dir = (argc > 1) ? argv[1] : "public_benchs";
+  mt19937 rng(2018);
+  bool ok = true;
+
+  printf("AVX2 evaluator: %s\n", has_avx2() ? "yes" : "no (scalar fallback)");
+  printf("%-24s %8s %4s %12s %12s %12s %12s %9s %9s %9s\n", "instance", "cars", "M",
+      "stations us", "kernels us", "scalar us", "vector us", "kernels", "scalar", "vector");
+
+  // We time every file of the public benchs in name order.
+  vector<string> files;
+  if (DIR* d = opendir(dir.c_str())) {
+    while (dirent* entry = readdir(d)) {
+      string file = entry->d_name;
+      if (file.size() > 4 && file.substr(file.size() - 4) == ".txt") files.push_back(file);
+    }
+    closedir(d);
+  }
+  sort(files.begin(), files.end());
+  for (int i = 0; i < int(files.size()); ++i)
+    ok = bench(files[i], read_instance(dir + "/" + files[i]), rng) && ok;
+
+  // We time synthetic instances from ten thousand to a million cars.
+  for (int cars = 10000; cars <= 1000000; cars *= 10) {
+    instance_shape shape;
+    shape.cars = cars;
+    shape.improvements = 40;
+    shape.classes = 10;
+    ok = bench("synthetic-" + to_string(cars), generate_instance(shape, rng), rng) && ok;
+  }
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,227 @@
+/*
+  ________________________
+ /\                       \
+ \_|   SCALING BENCHMARK  |
+   |                      |
+   |   bench_scaling.cc   |
+   |   ___________________|_
+    \_/_____________________/
+*/
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <map>
+#include <random>
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "instance.h"
+#include "checker.h"
+#include "synthetic.h"
+using namespace std;
+
+// Data structure that keeps a run of a solver on a generated instance: its
+// size, its files and what the run measured and got. 'work' is the number
+// of moves or nodes the solver reports and 'unit' what they are.
+struct run {
+  string solver;
+  int cars = 0, stations = 0;
+  string input, output, log;
+  string status;
+  double wall = 0;
+  long peak_rss = 0;
+  int penalty = -1, greedy = -1;
+  long long work = 0;
+  double rate = 0;
+  string unit;
+};
+
+// Function that splits a list of integers separated by commas.
+vector<long long> split_list(const string& list) {
+  vector<long long> values;
+  stringstream in(list);
+  for (string value; getline(in, value, ','); ) values.push_back(atoll(value.c_str()));
+  return values;
+}
+
+// Function that runs a solver 'solver' on a run with the arguments 'args',
+// with its standard output thrown away and its standard error kept in the
+// log of the run. The solver is killed after 'deadline' seconds.
+void execute(run& r, const string& solver, const vector<string>& args, double deadline) {
+  vector<string> words = {solver, r.input, r.output};
+  words.insert(words.end(), args.begin(), args.end());
+  remove(r.output.c_str());
+  wall_clock::time_point start = wall_clock::now();
+  pid_t pid = fork();
+  if (pid == 0) {
+    int null = open("/dev/null", O_WRONLY);
+    int log = open(r.log.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    dup2(null, 1);
+    dup2(log, 2);
+    vector<char*> argv;
+    for (int w = 0; w < int(words.size()); ++w) argv.push_back(const_cast<char*>(words[w].c_str()));
+    argv.push_back(NULL);
+    execv(solver.c_str(), argv.data());
+    _exit(127);
+  }
+
+  // We wait for the solver, killing it if it passes the deadline.
+  int status = 0;
+  struct rusage usage;
+  bool killed = false;
+  while (true) {
+    pid_t done = wait4(pid, &status, WNOHANG, &usage);
+    if (done == pid || (done < 0 && errno != EINTR)) break;
+    if (!killed && seconds_since(start) > deadline) {
+      kill(pid, SIGKILL);
+      killed = true;
+    }
+    usleep(2000);
+  }
+  r.wall = seconds_since(start);
+  r.peak_rss = usage.ru_maxrss;
+  if (killed) r.status = "TIMEOUT";
+  else if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) r.status = "FAILED";
+}
+
+// Function that reads the work that a solver reports in its log, as in
+// 'evaluated N moves in T s, R moves/s' or 'explored N nodes ...'.
+void read_work(run& r) {
+  ifstream in(r.log);
+  string line;
+  char unit[16];
+  long long work;
+  double seconds;
+  while (getline(in, line))
+    if (sscanf(line.c_str(), "evaluated %lld %15s in %lf", &work, unit, &seconds) == 3
+        || sscanf(line.c_str(), "explored %lld %15s in %lf", &work, unit, &seconds) == 3) {
+      r.work = work;
+      r.unit = unit;
+      r.rate = work / max(seconds, 1e-9);
+    }
+}
+
+// Function that returns a bar of 'width' characters at most for a value
+// 'value' on a logarithmic scale from 1 to 'top'.
+string log_bar(double value, double top, int width) {
+  if (value < 1 || top <= 1) return "";
+  return string(max(1, int(width * log10(value) / log10(top) + 0.5)), '#');
+}
+
+int main(int argc, char** argv) {
+  // We read the solvers, the sizes of the instances to sweep, the number of
+  // classes, the time budget of every run, the largest product of cars and
+  // stations to run, the seed of the instances and the files to write.
+  string solvers = get_option(argc, argv, "--solvers", string("greedy,mh,tabu,exh"));
+  vector<long long> cars = split_list(get_option(argc, argv, "--cars",
+      string("100,1000,10000,100000,1000000")));
+  vector<long long> stations = split_list(get_option(argc, argv, "--stations",
+      string("5,20,50,200")));
+  int classes = get_option(argc, argv, "--classes", 20);
+  double budget = get_option(argc, argv, "--time-limit", 1.0);
+  double max_size = get_option(argc, argv, "--max-size", 5e7);
+  unsigned seed = get_option(argc, argv, "--seed", 1u);
+  string csv = get_option(argc, argv, "--csv", string("bench-scaling.csv"));
+  string out = get_option(argc, argv, "--out", string("/tmp/bench-scaling"));
+  mkdir(out.c_str(), 0755);
+  vector<string> names;
+  stringstream list(solvers);
+  for (string name; getline(list, name, ','); ) names.push_back(name);
+
+  // We generate an instance of every size, and run the greedy algorithm
+  // first so that the other solvers are compared with its penalty.
+  vector<run> runs;
+  string time_limit = to_string(budget);
+  for (int c = 0; c < int(cars.size()); ++c)
+    for (int m = 0; m < int(stations.size()); ++m) {
+      string input = out + "/scale-" + to_string(cars[c]) + "-" + to_string(stations[m]) + ".txt";
+      bool skip = double(cars[c]) * stations[m] > max_size;
+      instance inst;
+      if (!skip) {
+        instance_shape shape;
+        shape.cars = cars[c];
+        shape.improvements = stations[m];
+        shape.classes = min<long long>(classes, cars[c]);
+        mt19937 rng(seed + c * stations.size() + m);
+        inst = generate_instance(shape, rng);
+        write_instance(inst, input);
+      }
+      int greedy = -1;
+      for (int s = 0; s < int(names.size()); ++s) {
+        run r;
+        r.solver = names[s];
+        r.cars = cars[c];
+        r.stations = stations[m];
+        r.input = input;
+        r.output = out + "/" + names[s] + "-" + to_string(cars[c]) + "-" + to_string(stations[m]) + ".txt";
+        r.log = r.output + ".log";
+        if (skip) r.status = "SKIPPED";
+        else {
+          execute(r, "./" + names[s] + ".exe", {"--time-limit", time_limit}, 3 * budget + 5);
+          read_work(r);
+          solution_file solution;
+          string error;
+          struct stat info;
+          if (r.status.empty() && stat(r.output.c_str(), &info) != 0) r.status = "NONE";
+          if (r.status.empty()) {
+            if (!read_solution(r.output, solution, error) || !check_solution(inst, solution, error))
+              r.status = "INVALID";
+            else {
+              r.status = "OK";
+              r.penalty = solution.penalty;
+              if (names[s] == "greedy") greedy = r.penalty;
+            }
+          }
+          remove(r.output.c_str());
+        }
+        r.greedy = greedy;
+        runs.push_back(r);
+        printf("%-8s %8d cars %4d stations %-8s penalty %d\n", r.solver.c_str(), r.cars,
+            r.stations, r.status.c_str(), r.penalty);
+        fflush(stdout);
+      }
+      remove(input.c_str());
+    }
+
+  // We write every run in a CSV file.
+  ofstream table(csv);
+  table << "solver,cars,stations,status,penalty,greedy_penalty,wall_seconds,peak_rss_kb,"
+      "work,work_per_second,unit\n";
+  for (int k = 0; k < int(runs.size()); ++k) {
+    const run& r = runs[k];
+    table << r.solver << ',' << r.cars << ',' << r.stations << ',' << r.status << ','
+        << r.penalty << ',' << r.greedy << ',' << r.wall << ',' << r.peak_rss << ','
+        << r.work << ',' << (long long) r.rate << ',' << r.unit << '\n';
+  }
+
+  // We plot the throughput of every solver on a logarithmic scale, and its
+  // quality as the share of the penalty of the greedy algorithm it keeps.
+  double top = 1;
+  for (int k = 0; k < int(runs.size()); ++k) top = max(top, runs[k].rate);
+  for (int s = 0; s < int(names.size()); ++s) {
+    printf("\n%s\n%8s %8s %-10s %12s %-42s %10s %10s\n", names[s].c_str(), "cars", "stations",
+        "status", "work/s", "", "penalty", "vs greedy");
+    for (int k = 0; k < int(runs.size()); ++k) {
+      const run& r = runs[k];
+      if (r.solver != names[s]) continue;
+      string quality = (r.penalty >= 0 && r.greedy > 0)
+          ? to_string(int(100.0 * r.penalty / r.greedy + 0.5)) + "%" : "-";
+      printf("%8d %8d %-10s %12.0f %-42s %10d %10s\n", r.cars, r.stations, r.status.c_str(),
+          r.rate, log_bar(r.rate, top, 40).c_str(), r.penalty, quality.c_str());
+    }
+  }
+  int failures = 0;
+  for (int k = 0; k < int(runs.size()); ++k)
+    if (runs[k].status == "FAILED" || runs[k].status == "INVALID") ++failures;
+  printf("\n%d runs, %d failed or invalid\n", int(runs.size()), failures);
+  return failures > 0 ? 1 : 0;
+}
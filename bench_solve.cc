@@ -0,0 +1,173 @@
+/*
+  ________________________
+ /\                       \
+ \_|   SOLVER BENCHMARK   |
+   |                      |
+   |    bench_solve.cc    |
+   |   ___________________|_
+    \_/_____________________/
+*/
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <map>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "instance.h"
+#include "checker.h"
+using namespace std;
+
+// Data structure that keeps a run of the solver on a bench: its files, the
+// process running it and what the run measured and got.
+struct job {
+  string level, name, input, output;
+  pid_t pid = -1;
+  wall_clock::time_point start;
+  double wall = 0;
+  long peak_rss = 0;
+  int exit_status = 0;
+  string status;
+  int penalty = -1, baseline = -1;
+  double seconds = 0;
+};
+
+// Function that reads the penalties of a baseline file of the 'solutions'
+// folder, which lists every bench as 'i:' followed by its solution.
+map<int, int> read_baseline(const string& path) {
+  map<int, int> penalties;
+  ifstream in(path);
+  string line;
+  int bench = -1;
+  while (getline(in, line)) {
+    if (!line.empty() && line.back() == ':') bench = atoi(line.c_str());
+    else if (bench >= 0 && !line.empty()) {
+      penalties[bench] = atoi(line.c_str());
+      bench = -1;
+    }
+  }
+  return penalties;
+}
+
+// Function that starts the solver 'solver' on a job with the arguments 'args',
+// with its standard output and error thrown away.
+void start_job(job& j, const string& solver, const vector<string>& args) {
+  vector<string> words = {solver, j.input, j.output};
+  words.insert(words.end(), args.begin(), args.end());
+  j.start = wall_clock::now();
+  j.pid = fork();
+  if (j.pid == 0) {
+    int null = open("/dev/null", O_WRONLY);
+    dup2(null, 1);
+    dup2(null, 2);
+    vector<char*> argv;
+    for (int w = 0; w < int(words.size()); ++w) argv.push_back(const_cast<char*>(words[w].c_str()));
+    argv.push_back(NULL);
+    execv(solver.c_str(), argv.data());
+    _exit(127);
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    cerr << "Syntax is: " << argv[0] << " solver [--jobs N] [--levels easy,med,hard]"
+        << " [--csv file] [--out dir] [-- solver options]" << endl;
+    return 1;
+  }
+  // We read the options of the benchmark, which are the ones before '--',
+  // and pass the ones after it to the solver.
+  string name = argv[1];
+  int options = 1;
+  while (options < argc && string(argv[options]) != "--") ++options;
+  vector<string> args(argv + min(argc, options + 1), argv + argc);
+  int jobs = max(1, get_option(options, argv, "--jobs", 1));
+  string levels = get_option(options, argv, "--levels", string("easy,med,hard"));
+  string csv = get_option(options, argv, "--csv", "bench-" + name + ".csv");
+  string out = get_option(options, argv, "--out", "/tmp/bench-" + name);
+  string solver = "./" + name + ".exe";
+  mkdir(out.c_str(), 0755);
+
+  // We set up a job for every bench of the levels, from 'level-1' on
+  // while the files exist.
+  vector<job> work;
+  map<string, map<int, int>> baselines;
+  stringstream list(levels);
+  for (string level; getline(list, level, ','); ) {
+    baselines[level] = read_baseline("solutions/solutions-" + name + "-" + level + ".txt");
+    for (int i = 1; ; ++i) {
+      job j;
+      j.level = level;
+      j.name = level + "-" + to_string(i);
+      j.input = "public_benchs/" + j.name + ".txt";
+      j.output = out + "/" + j.name + ".txt";
+      struct stat info;
+      if (stat(j.input.c_str(), &info) != 0) break;
+      if (baselines[level].count(i)) j.baseline = baselines[level][i];
+      work.push_back(j);
+    }
+  }
+
+  // We run the jobs with at most 'jobs' at once, measuring the wall time
+  // and the peak memory of every one when it ends.
+  int next = 0, running = 0;
+  map<pid_t, int> owner;
+  while (next < int(work.size()) || running > 0) {
+    if (next < int(work.size()) && running < jobs) {
+      remove(work[next].output.c_str());
+      start_job(work[next], solver, args);
+      owner[work[next].pid] = next;
+      ++next;
+      ++running;
+      continue;
+    }
+    int status;
+    struct rusage usage;
+    pid_t pid = wait4(-1, &status, 0, &usage);
+    if (pid < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    job& j = work[owner[pid]];
+    j.wall = seconds_since(j.start);
+    j.peak_rss = usage.ru_maxrss;
+    j.exit_status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    --running;
+  }
+
+  // We check every solution and compare its penalty with the baseline.
+  int failures = 0;
+  ofstream table(csv);
+  table << "solver,instance,status,penalty,baseline,wall_seconds,peak_rss_kb,solver_seconds\n";
+  printf("%-10s %-12s %8s %8s %10s %10s\n", "instance", "status", "penalty", "baseline", "wall s", "rss KB");
+  for (int k = 0; k < int(work.size()); ++k) {
+    job& j = work[k];
+    solution_file solution;
+    string error;
+    if (j.exit_status != 0) j.status = "FAILED";
+    else if (!read_solution(j.output, solution, error)
+        || !check_solution(read_instance(j.input), solution, error)) j.status = "INVALID";
+    else {
+      j.penalty = solution.penalty;
+      j.seconds = solution.seconds;
+      if (j.baseline < 0) j.status = "NEW";
+      else if (j.penalty > j.baseline) j.status = "REGRESSION";
+      else if (j.penalty < j.baseline) j.status = "IMPROVED";
+      else j.status = "OK";
+    }
+    if (j.status == "FAILED" || j.status == "INVALID" || j.status == "REGRESSION") ++failures;
+    table << name << ',' << j.name << ',' << j.status << ',' << j.penalty << ',' << j.baseline
+        << ',' << j.wall << ',' << j.peak_rss << ',' << j.seconds << '\n';
+    printf("%-10s %-12s %8d %8d %10.3f %10ld\n", j.name.c_str(), j.status.c_str(),
+        j.penalty, j.baseline, j.wall, j.peak_rss);
+    if (!error.empty()) printf("  %s\n", error.c_str());
+  }
+  printf("%d runs, %d failed, invalid or worse than the baseline\n", int(work.size()), failures);
+  return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,323 @@
+/*
+  ________________________
+ /\                       \
+ \_|    SOLUTION CACHE    |
+   |                      |
+   |        cache.h       |
+   |   ___________________|_
+    \_/_____________________/
+*/
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <string>
+#include <vector>
+#include <climits>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include "instance.h"
+#include "penalty.h"
+#include "checker.h"
+
+// The solvers can keep the best solutions they find in a cache folder given
+// with '--cache'. The cache has a file for every shape of instance, which is
+// named by a hash of its stations and of the upgrades of its classes, and
+// keeps the last 'CACHE_ENTRIES' solutions found for instances of that shape
+// with the number of cars of every class. A solver starts from the solution
+// of the entry with the closest numbers of cars, repaired to the ones of its
+// instance, unless it is more than 'MAX_REPAIR' cars away.
+const int CACHE_ENTRIES = 16;
+const int MAX_REPAIR = 256;
+
+// Data structure that keeps an entry of the cache: the penalty, the number
+// of cars of every class and the sequence of a solution.
+struct cache_entry {
+  int penalty;
+  std::vector<int> counts;
+  std::vector<int> sequence;
+};
+
+// Function that adds an integer 'value' to a 64-bit FNV-1a hash 'hash'.
+inline void hash_int(uint64_t& hash, uint64_t value) {
+  for (int b = 0; b < 8; ++b) {
+    hash ^= (value >> (8 * b)) & 0xff;
+    hash *= 1099511628211ULL;
+  }
+}
+
+// Function that returns the hash of the shape of an instance, which is its
+// stations and the upgrades of its classes.
+inline uint64_t instance_hash(const instance& inst) {
+  uint64_t hash = 14695981039346656037ULL;
+  hash_int(hash, inst.improvements);
+  hash_int(hash, inst.classes);
+  for (int s = 0; s < inst.improvements; ++s) {
+    hash_int(hash, inst.resources[s].first);
+    hash_int(hash, inst.resources[s].second);
+  }
+  for (int w = 0; w < int(inst.masks.size()); ++w) hash_int(hash, inst.masks[w]);
+  return hash;
+}
+
+// Function that returns the file of the cache folder 'dir' for the shape
+// of an instance.
+inline std::string cache_path(const std::string& dir, const instance& inst) {
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.txt", (unsigned long long) instance_hash(inst));
+  return dir + "/" + name;
+}
+
+// Function that reads the entries of a cache file 'path' for the shape of an
+// instance. An entry is a line with its penalty and the number of cars of
+// every class, followed by a line with its sequence. The entries that do
+// not match the shape are left out.
+inline std::vector<cache_entry> read_cache(const std::string& path, const instance& inst) {
+  std::vector<cache_entry> entries;
+  FILE* in = fopen(path.c_str(), "rb");
+  if (!in) return entries;
+  std::string text;
+  char buffer[1 << 16];
+  for (size_t size; (size = fread(buffer, 1, sizeof(buffer), in)) > 0; ) text.append(buffer, size);
+  fclose(in);
+
+  int_scanner scan = {text.data(), text.data() + text.size()};
+  for (cache_entry entry; scan.next(entry.penalty); ) {
+    entry.counts.assign(inst.classes, 0);
+    long long cars = 0;
+    bool ok = true;
+    for (int c = 0; c < inst.classes && ok; ++c) {
+      ok = scan.next(entry.counts[c]) && entry.counts[c] >= 0;
+      cars += entry.counts[c];
+    }
+    if (!ok || cars > INT_MAX) break;
+    // We check that the sequence has the cars the entry says.
+    std::vector<int> left = entry.counts;
+    entry.sequence.assign(cars, 0);
+    for (long long p = 0; p < cars && ok; ++p)
+      ok = scan.next(entry.sequence[p]) && entry.sequence[p] >= 0
+          && entry.sequence[p] < inst.classes && left[entry.sequence[p]]-- > 0;
+    if (!ok) break;
+    entries.push_back(entry);
+  }
+  return entries;
+}
+
+// Function that writes the entries of a cache file 'path'. They are written
+// in a temporary file that then replaces 'path', so that a solver that reads
+// the cache at the same time never finds a file written by half.
+inline void write_cache(const std::string& path, const std::vector<cache_entry>& entries) {
+  std::string text;
+  for (int e = 0; e < int(entries.size()); ++e) {
+    const cache_entry& entry = entries[e];
+    append_int(text, entry.penalty);
+    for (int c = 0; c < int(entry.counts.size()); ++c) {
+      text.push_back(' ');
+      append_int(text, entry.counts[c]);
+    }
+    text.push_back('\n');
+    for (int p = 0; p < int(entry.sequence.size()); ++p) {
+      if (p > 0) text.push_back(' ');
+      append_int(text, entry.sequence[p]);
+    }
+    text.push_back('\n');
+  }
+  std::string temporary = path + ".tmp";
+  if (FILE* out = fopen(temporary.c_str(), "wb")) {
+    bool ok = fwrite(text.data(), 1, text.size(), out) == text.size();
+    if ((fclose(out) == 0) && ok) std::rename(temporary.c_str(), path.c_str());
+    else remove(temporary.c_str());
+  }
+}
+
+// Function that computes the change of penalty of turning the car at the
+// index 'p' of a sequence of 'n' cars from a class 'from' into a class 'to',
+// where -1 stands for a car without upgrades, by only visiting the windows
+// of the window table 'table' that hold it. If 'apply' is set, the window
+// table is updated.
+inline int slot_delta(window_table& table, const instance& inst, int n, int p,
+    int from, int to, bool apply) {
+
+  int delta = 0;
+  for (int s = 0; s < inst.improvements; ++s) {
+    bool had = from >= 0 && inst.has(from, s), needs = to >= 0 && inst.has(to, s);
+    if (had == needs) continue;
+    int d = needs ? 1 : -1;
+    int capacity = inst.resources[s].first, window = inst.resources[s].second;
+    std::vector<int>& counts = table.counts[s];
+    // We visit the windows that end at an index 'k' from 'p' on.
+    for (int k = p, last = std::min(p + window - 1, n - 1); k <= last; ++k) {
+      delta += excess(counts[k] + d, capacity) - excess(counts[k], capacity);
+      if (apply) counts[k] += d;
+    }
+    // We visit the incomplete windows at the end that start before 'p'.
+    int first = tail_start(n, window);
+    for (int t = first, last = std::min(p, n - 2); t <= last; ++t) {
+      int& c = counts[n + t - first];
+      delta += excess(c + d, capacity) - excess(c, capacity);
+      if (apply) c += d;
+    }
+  }
+  return delta;
+}
+
+// Function that fills the entries from 'lo' to 'hi' of 'deltas' with the
+// change of penalty of turning the car at every index 'p' of a solution
+// into a class 'to', or of putting a car of 'to' there if 'insert' is set.
+inline void slot_deltas(window_table& table, const instance& inst,
+    const std::vector<int>& solution, bool insert, int to, int lo, int hi,
+    std::vector<int>& deltas) {
+
+  int n = solution.size();
+  for (int p = std::max(lo, 0); p <= std::min(hi, n - 1); ++p)
+    deltas[p] = slot_delta(table, inst, n, p, insert ? -1 : solution[p], to, false);
+}
+
+// Function that repairs a solution 'cached' of an instance of the same shape
+// to the number of cars of the classes of an instance 'inst' with as few
+// changes as it can. A car of a class in excess is first turned into one of
+// a class that is short of cars, then the ones still in excess are taken out
+// and the ones still missing are put in, each at the index where it adds the
+// least penalty in the windows of the cached sequence. The change of every
+// index is computed once per class, and after every change only the indexes
+// that share a window with it are computed again.
+inline std::vector<int> repair_solution(const std::vector<int>& cached, const instance& inst) {
+  int n = cached.size();
+  std::vector<int> solution = cached;
+  if (n == 0) {
+    for (int c = 0; c < inst.classes; ++c) solution.insert(solution.end(), inst.models[c].num_cars, c);
+    return solution;
+  }
+  // We count the cars left over (positive) or missing (negative) of every class.
+  std::vector<int> extra(inst.classes, 0);
+  for (int p = 0; p < n; ++p) ++extra[cached[p]];
+  for (int c = 0; c < inst.classes; ++c) extra[c] -= inst.models[c].num_cars;
+  window_table table;
+  build_windows(solution, table, inst);
+  int reach = 1;
+  for (int s = 0; s < inst.improvements; ++s) reach = std::max(reach, inst.resources[s].second);
+  std::vector<int> deltas(n);
+
+  // We turn cars left over into the missing ones.
+  for (int c = 0; c < inst.classes; ++c) {
+    if (extra[c] < 0) slot_deltas(table, inst, solution, false, c, 0, n - 1, deltas);
+    while (extra[c] < 0) {
+      int best = -1, best_delta = INT_MAX;
+      for (int p = 0; p < n; ++p)
+        if (extra[solution[p]] > 0 && deltas[p] < best_delta) { best_delta = deltas[p]; best = p; }
+      if (best < 0) break;
+      slot_delta(table, inst, n, best, solution[best], c, true);
+      --extra[solution[best]];
+      solution[best] = c;
+      ++extra[c];
+      slot_deltas(table, inst, solution, false, c, best - reach + 1, best + reach - 1, deltas);
+    }
+  }
+  // We take the cars still left over out by leaving their indexes without
+  // upgrades (-1).
+  for (int c = 0; c < inst.classes; ++c) {
+    if (extra[c] > 0) slot_deltas(table, inst, solution, false, -1, 0, n - 1, deltas);
+    while (extra[c] > 0) {
+      int best = -1, best_delta = INT_MAX;
+      for (int p = 0; p < n; ++p)
+        if (solution[p] == c && deltas[p] < best_delta) { best_delta = deltas[p]; best = p; }
+      slot_delta(table, inst, n, best, c, -1, true);
+      solution[best] = -1;
+      --extra[c];
+      slot_deltas(table, inst, solution, false, -1, best - reach + 1, best + reach - 1, deltas);
+    }
+  }
+
+  // We put the missing cars before the indexes where they add the least
+  // penalty, and build the repaired sequence.
+  std::vector<std::vector<int>> before(n + 1);
+  for (int c = 0; c < inst.classes; ++c) {
+    if (extra[c] < 0) slot_deltas(table, inst, solution, true, c, 0, n - 1, deltas);
+    for (; extra[c] < 0; ++extra[c]) {
+      int best = 0, best_delta = INT_MAX;
+      for (int p = 0; p <= n; ++p) {
+        int delta = deltas[std::min(p, n - 1)];
+        if (delta < best_delta) { best_delta = delta; best = p; }
+      }
+      int at = std::min(best, n - 1);
+      slot_delta(table, inst, n, at, -1, c, true);
+      before[best].push_back(c);
+      slot_deltas(table, inst, solution, true, c, at - reach + 1, at + reach - 1, deltas);
+    }
+  }
+  std::vector<int> repaired;
+  repaired.reserve(inst.cars);
+  for (int p = 0; p <= n; ++p) {
+    repaired.insert(repaired.end(), before[p].begin(), before[p].end());
+    if (p < n && solution[p] >= 0) repaired.push_back(solution[p]);
+  }
+  return repaired;
+}
+
+// Function that looks in the cache folder 'dir' for the entry closest to an
+// instance and repairs its sequence into a solution 'solution' of it with a
+// penalty 'penalty'. It returns false if there is no entry close enough.
+inline bool warm_start(const std::string& dir, const instance& inst,
+    std::vector<int>& solution, int& penalty) {
+
+  if (dir.empty()) return false;
+  std::vector<cache_entry> entries = read_cache(cache_path(dir, inst), inst);
+  int nearest = -1;
+  long long nearest_distance = LLONG_MAX;
+  for (int e = 0; e < int(entries.size()); ++e) {
+    long long distance = 0;
+    for (int c = 0; c < inst.classes; ++c)
+      distance += std::abs(entries[e].counts[c] - inst.models[c].num_cars);
+    if (distance < nearest_distance || (distance == nearest_distance
+        && entries[e].penalty < entries[nearest].penalty)) {
+      nearest = e;
+      nearest_distance = distance;
+    }
+  }
+  if (nearest < 0 || nearest_distance > MAX_REPAIR) return false;
+  solution = (nearest_distance == 0) ? entries[nearest].sequence
+      : repair_solution(entries[nearest].sequence, inst);
+  penalty = sequence_penalty(solution, inst);
+  return true;
+}
+
+// Function that keeps a solution 'solution' of an instance with a penalty
+// 'penalty' in the cache folder 'dir'. It replaces the entry of the same
+// instance if it is better, and the oldest entries go once there are more
+// than 'CACHE_ENTRIES'.
+inline void store_solution(const std::string& dir, const instance& inst, int penalty,
+    const std::vector<int>& solution) {
+
+  if (dir.empty()) return;
+  mkdir(dir.c_str(), 0755);
+  std::string path = cache_path(dir, inst);
+  std::vector<cache_entry> entries = read_cache(path, inst);
+  cache_entry entry;
+  entry.penalty = penalty;
+  entry.sequence = solution;
+  for (int c = 0; c < inst.classes; ++c) entry.counts.push_back(inst.models[c].num_cars);
+  for (int e = 0; e < int(entries.size()); ++e)
+    if (entries[e].counts == entry.counts) {
+      if (entries[e].penalty <= penalty) entry = entries[e];
+      entries.erase(entries.begin() + e);
+      break;
+    }
+  entries.insert(entries.begin(), entry);
+  if (int(entries.size()) > CACHE_ENTRIES) entries.resize(CACHE_ENTRIES);
+  write_cache(path, entries);
+}
+
+// Function that keeps the solution written by a solver in a file 'path' in
+// the cache folder 'dir', if it is a valid solution of the instance.
+inline void store_solution_file(const std::string& dir, const instance& inst,
+    const std::string& path) {
+
+  if (dir.empty()) return;
+  solution_file solution;
+  std::string error;
+  if (read_solution(path, solution, error) && check_solution(inst, solution, error))
+    store_solution(dir, inst, solution.penalty, solution.sequence);
+}
+
+#endif
@@ -0,0 +1,31 @@
+/*
+  ________________________
+ /\                       \
+ \_|   SOLUTION CHECKER   |
+   |                      |
+   |       check.cc       |
+   |   ___________________|_
+    \_/_____________________/
+*/
+#include <iostream>
+#include <string>
+#include "instance.h"
+#include "checker.h"
+using namespace std;
+
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    cerr << "Syntax is: " << argv[0] << " input_file sol_file" << endl;
+    return 1;
+  }
+
+  // We read the instance of the problem and the solution to check.
+  instance inst = read_instance(argv[1]);
+  solution_file solution;
+  string error;
+  if (!read_solution(argv[2], solution, error) || !check_solution(inst, solution, error)) {
+    cout << error << endl;
+    return 1;
+  }
+  cout << "Solution is OK" << endl;
+}
@@ -0,0 +1,98 @@
+/*
+  ________________________
+ /\                       \
+ \_|  SOLUTION CHECKER    |
+   |                      |
+   |      checker.h       |
+   |   ___________________|_
+    \_/_____________________/
+*/
+#ifndef CHECKER_H
+#define CHECKER_H
+
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include "instance.h"
+#include "penalty.h"
+
+// Data structure that keeps a solution as it is read from a solution file:
+// the penalty it claims, the time it took in seconds and its sequence.
+struct solution_file {
+  int penalty = 0;
+  double seconds = 0;
+  std::vector<int> sequence;
+};
+
+// Function that reads a solution file 'path'. If it cannot, it returns
+// false and explains why in 'error'.
+inline bool read_solution(const std::string& path, solution_file& solution,
+    std::string& error) {
+
+  FILE* in = fopen(path.c_str(), "rb");
+  if (!in) {
+    error = "ERROR: Cannot open " + path;
+    return false;
+  }
+  std::string text;
+  char buffer[1 << 16];
+  for (size_t size; (size = fread(buffer, 1, sizeof(buffer), in)) > 0; ) text.append(buffer, size);
+  fclose(in);
+
+  // We read the penalty and the time of the first line with the standard
+  // scanner, as the time has decimals, and the sequence of the second one.
+  int consumed = 0;
+  if (sscanf(text.c_str(), "%d %lf%n", &solution.penalty, &solution.seconds, &consumed) < 2) {
+    error = "ERROR: Bad first line in " + path;
+    return false;
+  }
+  int_scanner scan = {text.data() + consumed, text.data() + text.size()};
+  solution.sequence.clear();
+  for (int value; scan.next(value); ) solution.sequence.push_back(value);
+  if (scan.p != scan.end && std::string(scan.p, scan.end).find_first_not_of(" \t\r\n") != std::string::npos) {
+    error = "ERROR: Bad sequence in " + path;
+    return false;
+  }
+  return true;
+}
+
+// Function that checks a solution of an instance: that it has all the cars
+// of every class and that it has the penalty it claims. If it does not, it
+// returns false and explains why in 'error'.
+inline bool check_solution(const instance& inst, const solution_file& solution,
+    std::string& error) {
+
+  // We check the number of cars and the number of cars of every class.
+  const std::vector<int>& sequence = solution.sequence;
+  if (int(sequence.size()) != inst.cars) {
+    error = "ERROR: Solution has " + std::to_string(sequence.size()) + " cars instead of "
+        + std::to_string(inst.cars);
+    return false;
+  }
+  std::vector<int> cars(inst.classes, 0);
+  for (int p = 0; p < inst.cars; ++p) {
+    if (sequence[p] < 0 || sequence[p] >= inst.classes) {
+      error = "ERROR: Solution has a car of class " + std::to_string(sequence[p])
+          + ", which does not exist";
+      return false;
+    }
+    ++cars[sequence[p]];
+  }
+  for (int c = 0; c < inst.classes; ++c)
+    if (cars[c] != inst.models[c].num_cars) {
+      error = "ERROR: Solution has " + std::to_string(cars[c]) + " cars of class "
+          + std::to_string(c) + " instead of " + std::to_string(inst.models[c].num_cars);
+      return false;
+    }
+
+  // We check the penalty with the full-sequence evaluator.
+  int penalty = sequence_penalty(sequence, inst);
+  if (penalty != solution.penalty) {
+    error = "ERROR: Solution has a cost of " + std::to_string(penalty)
+        + ", but it is claimed to have " + std::to_string(solution.penalty);
+    return false;
+  }
+  return true;
+}
+
+#endif
@@ -0,0 +1,77 @@
+/*
+  ________________________
+ /\                       \
+ \_| CONSTRUCTIVE GREEDY  |
+   |                      |
+   |    constructive.h    |
+   |   ___________________|_
+    \_/_____________________/
+*/
+#ifndef CONSTRUCTIVE_H
+#define CONSTRUCTIVE_H
+
+#include <algorithm>
+#include <vector>
+#include "instance.h"
+
+// Function that fills the solution index by index with the class that adds
+// the least excess to the windows that end at the index. A car of a class
+// adds one to the excess of every station it needs whose window already has
+// 'ce' upgrades, so we keep the upgrades of the last 'ne' - 1 cars of every
+// station in a sliding counter. Ties go to the class whose stations are the
+// most critical: the ones with the most upgrades left for the capacity of
+// the indexes left.
+inline void constructive(std::vector<int>& solution, std::vector<int>& used,
+    const instance& inst) {
+
+  int n = solution.size();
+  int stations = inst.improvements;
+  std::vector<int> window(stations, 0), demand(stations, 0);
+  std::vector<double> criticality(stations);
+  for (int c = 0; c < inst.classes; ++c)
+    for (int s = 0; s < stations; ++s)
+      if (inst.has(c, s)) demand[s] += inst.models[c].num_cars;
+
+  for (int k = 0; k < n; ++k) {
+    // We compute the criticality of every station for the indexes left.
+    int left = n - k;
+    for (int s = 0; s < stations; ++s) {
+      double capacity = double(inst.resources[s].first) * left / inst.resources[s].second;
+      criticality[s] = demand[s] / std::max(capacity, 1.0);
+    }
+
+    // We score the classes with cars left by their excess and criticality,
+    // walking only the stations set in their masks.
+    int best = -1, best_excess = 0;
+    double best_criticality = 0;
+    for (int c = 0; c < inst.classes; ++c) {
+      if (used[c] == inst.models[c].num_cars) continue;
+      int added = 0;
+      double critical = 0;
+      const uint64_t* mask = inst.mask(c);
+      for (int w = 0; w < inst.mask_words; ++w)
+        for (uint64_t bits = mask[w]; bits; bits &= bits - 1) {
+          int s = w * 64 + __builtin_ctzll(bits);
+          added += (window[s] >= inst.resources[s].first);
+          critical += criticality[s];
+        }
+      if (best < 0 || added < best_excess
+          || (added == best_excess && critical > best_criticality)) {
+        best = c;
+        best_excess = added;
+        best_criticality = critical;
+      }
+    }
+
+    // We put a car of the best class and slide the window counters.
+    solution[k] = best;
+    ++used[best];
+    for (int s = 0; s < stations; ++s) {
+      if (inst.has(best, s)) { ++window[s]; --demand[s]; }
+      int out = k - inst.resources[s].second + 1;
+      if (out >= 0 && inst.has(solution[out], s)) --window[s];
+    }
+  }
+}
+
+#endif
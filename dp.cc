@@ -0,0 +1,174 @@
+/*
+  ________________________
+ /\                       \
+ \_|  DYNAMIC PROGRAMMING |
+   |                      |
+   |         dp.cc        |
+   |   ___________________|_
+    \_/_____________________/
+*/
+#include <iostream>
+#include <vector>
+#include <string>
+#include <climits>
+#include <algorithm>
+#include <unordered_map>
+#include "instance.h"
+#include "penalty.h"
+using namespace std;
+
+// Data structure that keeps the value of a state of the dynamic program: the
+// smallest penalty of the windows that end at the indexes still to be filled
+// if 'exact' is set, or otherwise a lower bound of it.
+struct memo_entry {
+  int value;
+  bool exact;
+};
+
+// Data structure that keeps the dynamic program. A state is the number of
+// cars used of each class and the last 'history' classes placed, where
+// 'history' is the largest window minus one: the penalty of the windows that
+// are still to be completed only depends on them. The memo table stops
+// growing when it takes about 'memory_cap' bytes, and then the search goes on
+// as a branch and bound that uses the states already in the table.
+struct dp_state {
+  vector<int> solution, used;
+  sequence_bits bits;
+  suffix_bound bound;
+  int history = 0;
+  unordered_map<string, memo_entry> memo;
+  size_t memory = 0, memory_cap = 0;
+};
+
+// Function that appends a non-negative number 'value' to a key in groups of
+// seven bits, the last one with the high bit clear, so that the numbers of
+// a key can take any size and two different states never share a key.
+void append_varint(string& key, unsigned value) {
+  while (value >= 0x80) {
+    key.push_back(char((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  key.push_back(char(value));
+}
+
+// Function that encodes the state of the dynamic program before the index 'k'.
+string encode(const dp_state& dp, const instance& inst, int k) {
+  string key;
+  for (int c = 0; c < inst.classes; ++c) append_varint(key, dp.used[c]);
+  for (int p = max(0, k - dp.history); p < k; ++p) append_varint(key, dp.solution[p]);
+  return key;
+}
+
+// Function that fills the index 'k' of the solution with a car of a class
+// 'i' ('d' = 1) or takes it back ('d' = -1) to try another one.
+void extend(dp_state& dp, const instance& inst, int k, int i, int d) {
+  if (d > 0) {
+    dp.solution[k] = i;
+    place(dp.bits, inst, k, i);
+  }
+  dp.used[i] += d;
+  update_demand(dp.bound, inst, i, -d);
+}
+
+// Function that returns the smallest penalty of the windows that end at the
+// indexes from 'k' on, if it is smaller than 'budget'. Otherwise it returns a
+// lower bound of it that is not smaller than 'budget', so that the classes
+// that cannot improve the best completion found are pruned.
+int solve(int k, int budget, dp_state& dp, const instance& inst) {
+  // If the solution is completed, there are no windows left.
+  if (k == inst.cars) return 0;
+
+  // If we have already met the state, we use its value when it is exact
+  // or when its lower bound is enough to prune it.
+  string key = encode(dp, inst, k);
+  unordered_map<string, memo_entry>::iterator it = dp.memo.find(key);
+  if (it != dp.memo.end() && (it->second.exact || it->second.value >= budget))
+    return it->second.value;
+
+  // We compute, for all possible classes 'i', the penalty of the windows
+  // that end at 'k' and the lower bound of the rest, to try the most
+  // promising ones first.
+  vector<pair<int, pair<int, int>>> children;
+  for (int i = 0; i < inst.classes; ++i)
+    if (dp.used[i] < inst.models[i].num_cars) {
+      place(dp.bits, inst, k, i);
+      update_demand(dp.bound, inst, i, -1);
+      int cost = penalties(dp.bits, k, 0, inst);
+      int estimate = cost + suffix_penalty_bound(dp.bound, inst, dp.bits, k + 1);
+      update_demand(dp.bound, inst, i, 1);
+      children.push_back({estimate, {cost, i}});
+    }
+  sort(children.begin(), children.end());
+
+  // We keep the smallest value among the classes, which is exact when it
+  // is below the budget and a lower bound otherwise.
+  int value = INT_MAX;
+  for (int c = 0; c < int(children.size()); ++c) {
+    int limit = min(value, budget);
+    if (children[c].first >= limit) {
+      value = min(value, children[c].first);
+      break;
+    }
+    int cost = children[c].second.first, i = children[c].second.second;
+    extend(dp, inst, k, i, 1);
+    value = min(value, cost + solve(k+1, limit - cost, dp, inst));
+    extend(dp, inst, k, i, -1);
+  }
+
+  // We store the value of the state while there is room in the memo table.
+  memo_entry entry = {value, value < budget};
+  it = dp.memo.find(key);
+  if (it != dp.memo.end()) it->second = entry;
+  else if (dp.memory < dp.memory_cap) {
+    dp.memo.insert({key, entry});
+    dp.memory += key.capacity() + sizeof(memo_entry) + 64;
+  }
+  return value;
+}
+
+int main(int argc, char** argv) {
+  // We read the instance of the problem and merge its classes
+  // that need the same upgrades, as they are interchangeable.
+  instance original = read_instance(argv[1]);
+  vector<vector<int>> members;
+  instance inst = merge_classes(original, members);
+  // We read the memory for the memo table in megabytes ('--memory').
+  double megabytes = get_option(argc, argv, "--memory", 1024.0);
+
+  // We get the current time before executing
+  // the dynamic program of the solution.
+  wall_clock::time_point time;
+  time = wall_clock::now();
+
+  // We set up the dynamic program, whose states keep as many
+  // classes as the largest window of a station minus one.
+  dp_state dp;
+  dp.solution.assign(inst.cars, 0);
+  dp.used.assign(inst.classes, 0);
+  init_bits(dp.bits, inst, inst.cars);
+  init_bound(dp.bound, inst);
+  for (int s = 0; s < inst.improvements; ++s)
+    dp.history = max(dp.history, inst.resources[s].second - 1);
+  dp.memory_cap = size_t(megabytes * 1024 * 1024);
+
+  // We compute the smallest penalty of the whole sequence.
+  int penalty = solve(0, INT_MAX, dp, inst);
+
+  // We rebuild a solution with that penalty by picking at every index
+  // a class whose penalty plus the value of the rest matches it.
+  int left = penalty;
+  for (int k = 0; k < inst.cars; ++k)
+    for (int i = 0; i < inst.classes; ++i)
+      if (dp.used[i] < inst.models[i].num_cars) {
+        extend(dp, inst, k, i, 1);
+        int cost = penalties(dp.bits, k, 0, inst);
+        if (cost <= left && cost + solve(k+1, left - cost + 1, dp, inst) == left) {
+          left -= cost;
+          break;
+        }
+        extend(dp, inst, k, i, -1);
+      }
+
+  // We write in a file the solution found.
+  write_to_file(penalty, time, expand_classes(dp.solution, original, members), argv[2]);
+}
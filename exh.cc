@@ -8,165 +8,319 @@
     \_/_____________________/
 */
 #include <iostream>
-#include <fstream>
 #include <vector>
-#include <time.h>
+#include <deque>
+#include <climits>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include "instance.h"
+#include "penalty.h"
+#include "writer.h"
+#include "cache.h"
 using namespace std;
 
-// Data structure that sets the number of cars and
-// the assignment of improvements of a car model.
-struct car_model {
-  int num_cars;
-  vector<bool> upgrades;
-};
-
-// Function that writes the penalty, the computation time
-// and the sequence of a solution in a file 'argv'.
-void write_to_file(const int penalty, const clock_t time,
-    const vector<int>& solution, const string argv) {
+// We define the minimum penalty at a value close to infinity. It is shared
+// by all the threads of the search, so an improvement found by any of them
+// prunes the others at once, and it is only lowered under 'incumbent_mutex'
+// so that the last solution posted to the writer is always the best one.
+atomic<int> min_penalty(INT_MAX);
+mutex incumbent_mutex;
 
-  // We set an output stream with a precision of a decimal.
-  ofstream out(argv);
-  out.setf(ios::fixed); out.precision(1);
+// We define the instance as it is read and the original classes of every
+// class of the search, where the classes that need the same upgrades are
+// merged, so that the solutions are written with the classes of the input.
+instance original;
+vector<vector<int>> members;
 
-  // We write the penalty of the solution and the time to get it in seconds.
-  double seconds = float(clock() - time)/CLOCKS_PER_SEC;
-  out << penalty << ' ' << seconds << endl;
+// We define the time budget of the search and the smallest lower bound of
+// the subtrees left open when it is over, so that the gap between the best
+// solution found and the optimum can be bounded.
+time_budget budget;
+atomic<int> open_bound(INT_MAX);
 
-  // We write the sequence of the solution.
-  for (int i = 0; i < solution.size(); ++i)
-    (i == 0) ? out << solution[i] : out << ' ' << solution[i];
-  out << endl;
+// We define how many nodes a search visits between two readings of the clock.
+const int CLOCK_INTERVAL = 256;
 
-  // We close the file output stream.
-  out.close();
+// Function that records the lower bound 'estimate' of a subtree left open.
+void leave_open(int estimate) {
+  int bound = open_bound;
+  while (estimate < bound && !open_bound.compare_exchange_weak(bound, estimate));
 }
 
-// Function that computes penalties of all windows of a partial
-// solution that reach an index 'k' given a set of parameters.
-int penalties(const vector<int>& solution, int k, int partial_penalty,
-    const vector<car_model>& models, const vector<pair<int, int>>& resources) {
-
-  // We set the penalties we will calculate to
-  // zero and get the number of improvements.
-  int new_penalties = 0;
-  int improvements = models[0].upgrades.size();
-
-  // We calculate the penalties for each station 's'.
-  for (int s = 0; s < improvements; ++s) {
-
-    // We calculate the incomplete windows at the beginning of the sequence.
-    if (k < resources[s].second - 1) {
-      int num_upgrades = 0;
-      for (int p = 0; p <= k; ++p) // We sum the number of upgrades.
-        if (models[solution[p]].upgrades[s]) ++num_upgrades;
-      if (num_upgrades > resources[s].first) // We check and compute penalties.
-        new_penalties += num_upgrades - resources[s].first;
-    }
+// Data structure that keeps the state of a search: the partial solution,
+// its rows of upgrades, the used cars of each class and the lower bound.
+// When every station allows at least one upgrade, the penalty of a sequence
+// is the same as the one of its reverse, so we only search the sequences
+// whose first class is not greater than the last one: 'high_left' counts
+// the cars left of a class not smaller than the first one, and one of them
+// is always kept for the last index.
+struct search_state {
+  vector<int> solution;
+  vector<int> used;
+  sequence_bits bits;
+  suffix_bound bound;
+  bool break_reversal = false;
+  int high_left = 0;
+  long long nodes = 0;
+  bool expired = false;
+};
 
-    // We calculate the complete windows that reach the index 'k'.
-    if (k >= resources[s].second - 1) {
-      int num_upgrades = 0;
-      // We sum the number of upgrades.
-      for (int p = k - resources[s].second + 1; p <= k; ++p)
-        if (models[solution[p]].upgrades[s]) ++num_upgrades;
-      if (num_upgrades > resources[s].first) // We check and compute penalties.
-        new_penalties += num_upgrades - resources[s].first;
-    }
+// We count the nodes of the search tree visited by all the searches, which
+// are added when a search is done, to report the throughput of the run.
+atomic<long long> explored(0);
 
-    // We calculate the incomplete windows at the end of the sequence.
-    int n = solution.size();
-    if (k == n - 1) {
-      int i = n - resources[s].second + 1;
-      while (i < n - 1) { // We calculate windows up to that of mesure two.
-        int num_upgrades = 0;
-        for (int p = i; p <= k; ++p) // We sum the number of upgrades.
-          if (models[solution[p]].upgrades[s]) ++num_upgrades;
-        if (num_upgrades > resources[s].first) // We check and compute penalties.
-          new_penalties += num_upgrades - resources[s].first;
-        ++i;
-      }
-    }
+// Function that sets up the state of a search for an empty solution.
+void init_state(search_state& state, const instance& inst) {
+  state.solution.assign(inst.cars, 0);
+  state.used.assign(inst.classes, 0);
+  init_bits(state.bits, inst, inst.cars);
+  init_bound(state.bound, inst);
+  state.break_reversal = true;
+  for (int s = 0; s < inst.improvements; ++s)
+    if (inst.resources[s].first < 1) state.break_reversal = false;
+}
+
+// Function that tells whether a car of a class 'i' can be put at the index
+// 'k' without using the last car left for the end of the sequence.
+bool keeps_reversal(const search_state& state, const instance& inst, int k, int i) {
+  if (!state.break_reversal || k == 0 || k == inst.cars - 1) return true;
+  return i < state.solution[0] || state.high_left > 1;
+}
+
+// Function that fills the index 'k' of the solution with a car of a class
+// 'i' ('d' = 1) or takes it back ('d' = -1) to try another one.
+void extend(search_state& state, const instance& inst, int k, int i, int d) {
+  if (d > 0) {
+    state.solution[k] = i;
+    place(state.bits, inst, k, i);
+  }
+  state.used[i] += d;
+  update_demand(state.bound, inst, i, -d);
+  // We count the cars left of a class not smaller than the first one.
+  if (k == 0 && d > 0) {
+    state.high_left = -1;
+    for (int c = i; c < inst.classes; ++c) state.high_left += inst.models[c].num_cars;
   }
-  // We sum the new penalties until index 'k' plus the previous penalty.
-  return partial_penalty + new_penalties;
+  else if (k > 0 && i >= state.solution[0]) state.high_left -= d;
 }
 
-// We define the minimum penalty at a value close to infinity.
-int min_penalty = INT_MAX;
+// Function that computes, for all possible classes 'i' of the index 'k',
+// the penalty of the solution extended with a car of the class plus the
+// lower bound of the rest, and returns the ones that can still lead to a
+// smaller penalty sorted from the most promising, as {estimate, {i, penalty}},
+// so that the penalty of the extended solution is not computed again.
+vector<pair<int, pair<int, int>>> children(int k, int partial_penalty, search_state& state,
+    const instance& inst) {
+
+  vector<pair<int, pair<int, int>>> promising;
+  for (int i = 0; i < inst.classes; ++i)
+    // If we have not used all cars of a particular class, we try them.
+    if (state.used[i] < inst.models[i].num_cars && keeps_reversal(state, inst, k, i)) {
+      place(state.bits, inst, k, i);
+      update_demand(state.bound, inst, i, -1);
+      int penalty = penalties(state.bits, k, partial_penalty, inst);
+      int estimate = penalty + suffix_penalty_bound(state.bound, inst, state.bits, k + 1);
+      update_demand(state.bound, inst, i, 1);
+      if (estimate < min_penalty) promising.push_back({estimate, {i, penalty}});
+    }
+  sort(promising.begin(), promising.end());
+  return promising;
+}
 
 // Function that generates all possible ways to extend
 // a partial solution given a set of parameters.
-void generate(int k, vector<int>& solution, vector<int>& used, int partial_penalty,
-    const vector<car_model>& models, const vector<pair<int,int>>& resources,
-    const string argv, const clock_t time) {
-
-  // We store the size of the solution and the number of classes.
-  int n = solution.size();
-  int classes = models.size();
-
-  // If the solution is completed, we write it and update the minimum penalty.
-  if (k == n) {
-    write_to_file(partial_penalty, time, solution, argv);
-    min_penalty = partial_penalty;
+void generate(int k, int partial_penalty, search_state& state,
+    const instance& inst, solution_writer& out) {
+
+  // We look at the clock every few nodes, as reading it takes longer than
+  // visiting a node.
+  if (++state.nodes % CLOCK_INTERVAL == 0) state.expired = budget.expired();
+  // If the solution is completed, we write it and update the minimum penalty
+  // unless another thread has found a better one in the meantime.
+  if (k == inst.cars) {
+    lock_guard<mutex> lock(incumbent_mutex);
+    if (partial_penalty < min_penalty) {
+      out.post(partial_penalty, expand_classes(state.solution, original, members));
+      min_penalty = partial_penalty;
+    }
   }
 
-  // Otherwise we generate all possible ways to extend the partial solution.
+  // Otherwise we generate all possible ways to extend the partial solution,
+  // with the most promising classes first, so that good solutions are found
+  // soon and prune the rest of the tree.
   else {
-    // We extend the partial solution for all possible classes 'i'.
-    for (int i = 0; i < classes; ++i)
-      // If we have not used all cars of a particular class, we try them.
-      if (used[i] < models[i].num_cars) {
-        // We fill the solution with a car model and mark it as used.
-        solution[k] = i;
-        ++used[i];
-        // We keep the old penalty and compute the new penalty of the solution.
-        int old_penalty = partial_penalty;
-        partial_penalty = penalties(solution, k, partial_penalty, models, resources);
-        // We extend the solution only if we have found a smaller penalty.
-        if (partial_penalty < min_penalty)
-          generate(k+1, solution, used, partial_penalty, models, resources, argv, time);
-        // In case we do not extend the solution, we restore the old penalty.
-        partial_penalty = old_penalty;
-        --used[i];
+    vector<pair<int, pair<int, int>>> promising = children(k, partial_penalty, state, inst);
+    for (int c = 0; c < int(promising.size()); ++c) {
+      // We skip the class if a better solution has been found meanwhile.
+      if (promising[c].first >= min_penalty) break;
+      // If the time is over, we leave this class and the next ones open,
+      // whose lower bounds are not smaller than the one of this class.
+      if (state.expired) {
+        leave_open(promising[c].first);
+        break;
       }
+      // We fill the solution with a car model and mark it as used.
+      int i = promising[c].second.first;
+      extend(state, inst, k, i, 1);
+      generate(k+1, promising[c].second.second, state, inst, out);
+      // We take the car back before trying the next class.
+      extend(state, inst, k, i, -1);
+    }
 } }
 
+// Data structure that sets a subproblem of the parallel search: a prefix of
+// the solution, its penalty and the penalty plus the lower bound of the rest.
+struct subproblem {
+  vector<int> prefix;
+  int penalty;
+  int estimate;
+};
+
+// Function that splits the search tree at a depth 'depth' by collecting
+// the prefixes of that size that can still lead to a smaller penalty.
+void split(int k, int depth, int partial_penalty, int estimate, search_state& state,
+    const instance& inst, vector<subproblem>& tasks) {
+
+  if (k == depth) {
+    tasks.push_back({vector<int>(state.solution.begin(), state.solution.begin() + k),
+        partial_penalty, estimate});
+    return;
+  }
+  vector<pair<int, pair<int, int>>> promising = children(k, partial_penalty, state, inst);
+  for (int c = 0; c < int(promising.size()); ++c) {
+    int i = promising[c].second.first;
+    extend(state, inst, k, i, 1);
+    split(k+1, depth, promising[c].second.second, promising[c].first, state, inst, tasks);
+    extend(state, inst, k, i, -1);
+  }
+}
+
+// Data structure that sets the queue of subproblems of a thread. The owner
+// takes them from the back and the other threads steal them from the front.
+struct work_queue {
+  mutex lock;
+  deque<subproblem> tasks;
+};
+
+// Function that takes a subproblem for the thread 'id', first from its own
+// queue and otherwise stealing it from the queue of another thread.
+bool take_task(int id, vector<work_queue>& queues, subproblem& task) {
+  int threads = queues.size();
+  for (int v = 0; v < threads; ++v) {
+    work_queue& queue = queues[(id + v) % threads];
+    lock_guard<mutex> lock(queue.lock);
+    if (queue.tasks.empty()) continue;
+    if (v == 0) { task = queue.tasks.back(); queue.tasks.pop_back(); }
+    else { task = queue.tasks.front(); queue.tasks.pop_front(); }
+    return true;
+  }
+  return false;
+}
+
+// Function that runs a thread 'id' of the parallel search, which solves
+// subproblems until there are none left in any queue.
+void worker(int id, vector<work_queue>& queues, const instance& inst,
+    solution_writer& out) {
+
+  search_state state;
+  init_state(state, inst);
+  subproblem task;
+  while (take_task(id, queues, task)) {
+    // We skip the subproblem if a good enough solution has already been found.
+    if (task.estimate >= min_penalty) continue;
+    // If the time is over, we leave the subproblem open.
+    if (state.expired || budget.expired()) {
+      state.expired = true;
+      leave_open(task.estimate);
+      continue;
+    }
+    int k = task.prefix.size();
+    for (int p = 0; p < k; ++p) extend(state, inst, p, task.prefix[p], 1);
+    generate(k, task.penalty, state, inst, out);
+    for (int p = 0; p < k; ++p) extend(state, inst, p, task.prefix[p], -1);
+  }
+  explored += state.nodes;
+}
+
+// Function that solves the problem with 'threads' threads. The search tree
+// is split at a depth 'depth' and the subproblems are dealt in turns to the
+// queues of the threads from the most promising, so every thread starts
+// with good ones, and idle threads steal work from the others. Only whole
+// subproblems are stolen, so a subtree much heavier than the others is
+// still searched by a single thread; a deeper split makes them finer.
+void parallel_generate(int threads, int depth, const instance& inst,
+    solution_writer& out) {
+
+  search_state state;
+  init_state(state, inst);
+  vector<subproblem> tasks;
+  split(0, min(depth, inst.cars), 0, 0, state, inst, tasks);
+  stable_sort(tasks.begin(), tasks.end(), [](const subproblem& a, const subproblem& b) {
+    return a.estimate < b.estimate;
+  });
+
+  // The owner takes from the back, so each queue keeps its best at the back.
+  vector<work_queue> queues(threads);
+  for (int t = int(tasks.size()) - 1; t >= 0; --t)
+    queues[t % threads].tasks.push_back(tasks[t]);
+
+  vector<thread> pool;
+  for (int id = 0; id < threads; ++id)
+    pool.push_back(thread(worker, id, ref(queues), cref(inst), ref(out)));
+  for (int id = 0; id < threads; ++id) pool[id].join();
+}
+
 int main(int argc, char** argv) {
-  // We create an input stream class to operate on files.
-  ifstream in(argv[1]);
-
-  // We read the number of cars 'C', improvements 'M' and classes 'K'.
-  int cars, improvements, classes;
-  in >> cars >> improvements >> classes;
-  // We read the number of cars 'ce' which can require an
-  // improvement out of a window of 'ne' consecutive cars.
-  vector<pair<int,int>> resources(improvements);
-  for (int i = 0; i < improvements; ++i) in >> resources[i].first;
-  for (int i = 0; i < improvements; ++i) in >> resources[i].second;
-  // We read the number of cars of each class
-  // and whether they need or not an upgrade.
-  vector<car_model> models(classes);
-  int group; bool upgrade;
-  for (int i = 0; i < classes; ++i) {
-    in >> group >> models[group].num_cars;
-    for (int j = 0; j < improvements; ++j) {
-      in >> upgrade;
-      models[group].upgrades.push_back(upgrade);
-  } }
-
-  // We close the file input stream.
-  in.close();
-
-  // We get the current time before executing the
-  // exhaustive search algorithm of the solution.
-  clock_t time;
-  time = clock();
-
-  // We create a partial void solution that will be completed
-  // and a vector that will keep track of the used car classes.
-  vector<int> solution(cars);
-  vector<int> used(classes, 0);
-  // We generate all possible ways to extend the partial solution.
-  generate(0, solution, used, 0, models, resources, argv[2], time);
+  // We read the instance of the problem and merge its classes
+  // that need the same upgrades, as they are interchangeable.
+  original = read_instance(argv[1]);
+  instance inst = merge_classes(original, members);
+  // We read the number of threads and the depth at which the search tree
+  // is split in subproblems for them ('--threads' and '--split-depth').
+  int threads = get_option(argc, argv, "--threads", 1);
+  int depth = get_option(argc, argv, "--split-depth", 4);
+  // We read the folder of the cache of solutions ('--cache', none by default).
+  string cache = get_option(argc, argv, "--cache", string());
+
+  // We get the current time before executing the exhaustive search
+  // algorithm of the solution and read its time budget ('--time-limit').
+  wall_clock::time_point time;
+  time = wall_clock::now();
+  budget = read_budget(argc, argv, time);
+
+  // We generate all possible ways to extend the partial solution, with
+  // a single search or with a pool of threads that share the work. The
+  // best solutions are written in the background as they are found.
+  {
+    solution_writer out(argv[2], time);
+    // We start from the solution of the cache closest to the instance, if
+    // there is one, so that only better solutions are searched for.
+    vector<int> cached;
+    int cached_penalty;
+    if (warm_start(cache, original, cached, cached_penalty)) {
+      out.post(cached_penalty, cached);
+      min_penalty = cached_penalty;
+    }
+    if (threads <= 1) {
+      search_state state;
+      init_state(state, inst);
+      generate(0, 0, state, inst, out);
+      explored += state.nodes;
+    }
+    else parallel_generate(threads, depth, inst, out);
+  }
+  store_solution_file(cache, original, argv[2]);
+
+  // We report the best penalty found and its gap to the smallest lower
+  // bound of the subtrees left open, which is zero if the search is over,
+  // and the nodes visited and how many were visited every second.
+  int bound = min(int(open_bound), int(min_penalty));
+  if (min_penalty == INT_MAX) cerr << "no solution found, lower bound " << bound << endl;
+  else cerr << "penalty " << min_penalty << ", lower bound " << bound
+      << ", gap " << min_penalty - bound << endl;
+  double seconds = seconds_since(time);
+  cerr << "explored " << explored << " nodes in " << seconds << " s, "
+      << (long long) (explored / max(seconds, 1e-9)) << " nodes/s" << endl;
 }
@@ -0,0 +1,51 @@
+/*
+  ________________________
+ /\                       \
+ \_|  INSTANCE GENERATOR  |
+   |                      |
+   |        gen.cc        |
+   |   ___________________|_
+    \_/_____________________/
+*/
+#include <iostream>
+#include <random>
+#include <string>
+#include "instance.h"
+#include "synthetic.h"
+using namespace std;
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    cerr << "Syntax is: " << argv[0] << " output [--cars C] [--stations M] [--classes K]"
+        << " [--min-window a] [--max-window b] [--utilization r] [--load l] [--seed s]" << endl;
+    return 1;
+  }
+  // We read the shape of the instance: the number of cars ('--cars', 100 by
+  // default), stations ('--stations', 5) and classes ('--classes', 10), the
+  // range of the windows ('--min-window' and '--max-window', 2 and 33), the
+  // utilization 'ce' / 'ne' of the stations ('--utilization', at random from
+  // 0.1 to 0.9 if it is not given) and the share of their capacity the cars
+  // need ('--load', 0.9). The seed ('--seed', 1) sets the instance.
+  instance_shape shape;
+  shape.cars = get_option(argc, argv, "--cars", shape.cars);
+  shape.improvements = get_option(argc, argv, "--stations", shape.improvements);
+  shape.classes = get_option(argc, argv, "--classes", shape.classes);
+  shape.min_window = get_option(argc, argv, "--min-window", shape.min_window);
+  shape.max_window = get_option(argc, argv, "--max-window", shape.max_window);
+  shape.utilization = get_option(argc, argv, "--utilization", shape.utilization);
+  shape.load = get_option(argc, argv, "--load", shape.load);
+  unsigned seed = get_option(argc, argv, "--seed", 1u);
+  if (shape.cars < 0 || shape.improvements < 0 || shape.classes < 1
+      || (shape.cars > 0 && shape.classes > shape.cars)) {
+    cerr << "the instance needs at least one car of every class" << endl;
+    return 1;
+  }
+
+  // We generate the instance and write it in the format of the input files.
+  mt19937 rng(seed);
+  instance inst = generate_instance(shape, rng);
+  if (!write_instance(inst, argv[1])) {
+    cerr << "cannot write " << argv[1] << endl;
+    return 1;
+  }
+}
@@ -0,0 +1,322 @@
+/*
+  ________________________
+ /\                       \
+ \_|    INSTANCE MODEL    |
+   |                      |
+   |      instance.h      |
+   |   ___________________|_
+    \_/_____________________/
+*/
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <climits>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Data structure that sets the model, the number of cars
+// and the number of upgrades of a car model.
+struct car_model {
+  int model;
+  int num_cars;
+  int num_upgrades = 0;
+};
+
+// Data structure that holds an instance of the problem: the number of
+// cars 'C', improvements 'M' and classes 'K', the pair (ce, ne) of every
+// station and the car models indexed by class. The upgrades of a class
+// are packed in a mask of 'mask_words' words with one bit per station.
+struct instance {
+  int cars = 0, improvements = 0, classes = 0;
+  std::vector<std::pair<int,int>> resources;
+  std::vector<car_model> models;
+  int mask_words = 0;
+  std::vector<uint64_t> masks;
+
+  // Function that returns the station mask of a class 'c'.
+  const uint64_t* mask(int c) const { return &masks[c * mask_words]; }
+
+  // Function that tells whether a class 'c' needs an upgrade in a station 's'.
+  bool has(int c, int s) const {
+    return (masks[c * mask_words + (s >> 6)] >> (s & 63)) & 1;
+  }
+};
+
+// Data structure that scans the integers of a text in memory, as a faster
+// replacement of the stream operator for the large inputs.
+struct int_scanner {
+  const char* p;
+  const char* end;
+
+  // Function that reads the next integer into 'value' and returns
+  // whether there was one.
+  bool next(int& value) {
+    while (p < end && (*p == ' ' || *p == '\n' || *p == '\t' || *p == '\r')) ++p;
+    bool negative = (p < end && *p == '-');
+    if (negative) ++p;
+    if (p == end || *p < '0' || *p > '9') return false;
+    long long number = 0;
+    while (p < end && *p >= '0' && *p <= '9' && number <= INT_MAX) number = number * 10 + (*p++ - '0');
+    if (number > INT_MAX) return false;
+    value = negative ? -int(number) : int(number);
+    return true;
+  }
+};
+
+// Function that parses an instance from the text 'text' of 'size' bytes and
+// checks it. If it is not valid, it returns false and explains why in 'error'.
+inline bool parse_instance(const char* text, size_t size, instance& inst, std::string& error) {
+  int_scanner in = {text, text + size};
+  inst = instance();
+
+  // We read the number of cars 'C', improvements 'M' and classes 'K'.
+  if (!in.next(inst.cars) || !in.next(inst.improvements) || !in.next(inst.classes)
+      || inst.cars < 0 || inst.improvements < 0 || inst.classes < 0) {
+    error = "bad header";
+    return false;
+  }
+  // We read the number of cars 'ce' which can require an
+  // improvement out of a window of 'ne' consecutive cars.
+  inst.resources.resize(inst.improvements);
+  for (int i = 0; i < inst.improvements; ++i)
+    if (!in.next(inst.resources[i].first) || inst.resources[i].first < 0) {
+      error = "bad capacity of station " + std::to_string(i);
+      return false;
+    }
+  for (int i = 0; i < inst.improvements; ++i)
+    if (!in.next(inst.resources[i].second) || inst.resources[i].second < 1) {
+      error = "bad window of station " + std::to_string(i);
+      return false;
+    }
+  // We read the number of cars of each class and whether
+  // they need or not an upgrade, packing it in the masks.
+  inst.models.resize(inst.classes);
+  inst.mask_words = (inst.improvements + 63) / 64;
+  inst.masks.assign(size_t(inst.classes) * inst.mask_words, 0);
+  std::vector<bool> seen(inst.classes, false);
+  long long cars = 0;
+  int group, upgrade;
+  for (int i = 0; i < inst.classes; ++i) {
+    if (!in.next(group) || group < 0 || group >= inst.classes || seen[group]) {
+      error = "bad class in line " + std::to_string(i);
+      return false;
+    }
+    seen[group] = true;
+    car_model& model = inst.models[group];
+    model.model = group;
+    if (!in.next(model.num_cars) || model.num_cars < 0) {
+      error = "bad number of cars of class " + std::to_string(group);
+      return false;
+    }
+    cars += model.num_cars;
+    uint64_t* mask = &inst.masks[size_t(group) * inst.mask_words];
+    for (int j = 0; j < inst.improvements; ++j) {
+      if (!in.next(upgrade) || (upgrade != 0 && upgrade != 1)) {
+        error = "bad upgrade of class " + std::to_string(group);
+        return false;
+      }
+      if (upgrade) {
+        ++model.num_upgrades;
+        mask[j >> 6] |= uint64_t(1) << (j & 63);
+      }
+  } }
+
+  // We check that the classes have as many cars as the header says.
+  if (cars != inst.cars) {
+    error = "the classes have " + std::to_string(cars) + " cars instead of "
+        + std::to_string(inst.cars);
+    return false;
+  }
+  return true;
+}
+
+// Function that loads an instance from the file 'path', which is mapped in
+// memory and parsed in place. If it cannot, it returns false and explains
+// why in 'error'.
+inline bool load_instance(const std::string& path, instance& inst, std::string& error) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    error = "cannot open " + path;
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) < 0 || info.st_size == 0) {
+    close(fd);
+    error = "cannot read " + path;
+    return false;
+  }
+  size_t size = info.st_size;
+  void* text = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (text == MAP_FAILED) {
+    error = "cannot map " + path;
+    return false;
+  }
+  madvise(text, size, MADV_SEQUENTIAL);
+  bool ok = parse_instance(static_cast<const char*>(text), size, inst, error);
+  munmap(text, size);
+  if (!ok) error = path + ": " + error;
+  return ok;
+}
+
+// Function that reads an instance from the file 'path', or stops the
+// program if it is not valid.
+inline instance read_instance(const std::string& path) {
+  instance inst;
+  std::string error;
+  if (!load_instance(path, inst, error)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    exit(1);
+  }
+  return inst;
+}
+
+// Function that merges the classes of an instance that need the same upgrades,
+// which are interchangeable, into a single class with the cars of all of them.
+// 'members' gets the original classes of every merged class.
+inline instance merge_classes(const instance& inst,
+    std::vector<std::vector<int>>& members) {
+
+  instance merged = inst;
+  merged.classes = 0;
+  merged.models.clear();
+  merged.masks.clear();
+  members.clear();
+  for (int c = 0; c < inst.classes; ++c) {
+    // We look for a merged class with the same mask as the class 'c'.
+    int m = 0;
+    while (m < merged.classes && !std::equal(inst.mask(c), inst.mask(c) + inst.mask_words,
+        merged.masks.begin() + m * inst.mask_words)) ++m;
+    if (m == merged.classes) {
+      car_model model = inst.models[c];
+      model.model = m;
+      model.num_cars = 0;
+      merged.models.push_back(model);
+      merged.masks.insert(merged.masks.end(), inst.mask(c), inst.mask(c) + inst.mask_words);
+      members.push_back(std::vector<int>());
+      ++merged.classes;
+    }
+    merged.models[m].num_cars += inst.models[c].num_cars;
+    members[m].push_back(c);
+  }
+  return merged;
+}
+
+// Function that turns a solution of merged classes back into a solution
+// of the original classes, giving the cars of every merged class to its
+// members in turn.
+inline std::vector<int> expand_classes(const std::vector<int>& solution,
+    const instance& inst, const std::vector<std::vector<int>>& members) {
+
+  std::vector<int> left(inst.classes), next(members.size(), 0), original(solution.size());
+  for (int c = 0; c < inst.classes; ++c) left[c] = inst.models[c].num_cars;
+  for (int p = 0; p < int(solution.size()); ++p) {
+    int m = solution[p];
+    while (left[members[m][next[m]]] == 0) ++next[m];
+    original[p] = members[m][next[m]];
+    --left[original[p]];
+  }
+  return original;
+}
+
+// Function that returns the value given to an option 'name' in the
+// command line (as in '--threads 8'), or 'value' if it is not given.
+template <typename T>
+T get_option(int argc, char** argv, const std::string& name, T value) {
+  for (int i = 1; i + 1 < argc; ++i)
+    if (name == argv[i]) std::istringstream(argv[i + 1]) >> value;
+  return value;
+}
+
+// We measure times with a monotonic wall clock, which does not add up the
+// time of every thread as 'clock' does and is not moved by the system.
+typedef std::chrono::steady_clock wall_clock;
+
+// Function that returns the seconds passed since a time 'start'.
+inline double seconds_since(wall_clock::time_point start) {
+  return std::chrono::duration<double>(wall_clock::now() - start).count();
+}
+
+// Data structure that sets the time budget of a solver: the seconds given
+// with '--time-limit' from a time 'start', or no budget if 'limit' is zero.
+struct time_budget {
+  wall_clock::time_point start;
+  double limit = 0;
+
+  // Function that tells whether the time of the budget is over.
+  bool expired() const { return limit > 0 && seconds_since(start) >= limit; }
+
+  // Function that returns the fraction of the budget that has been used.
+  double used() const { return (limit > 0) ? std::min(1.0, seconds_since(start) / limit) : 0; }
+};
+
+// Function that reads the time budget of a solver started at 'start'.
+inline time_budget read_budget(int argc, char** argv, wall_clock::time_point start) {
+  time_budget budget;
+  budget.start = start;
+  budget.limit = get_option(argc, argv, "--time-limit", 0.0);
+  return budget;
+}
+
+// Function that appends a non-negative integer 'value' to a text 'out'.
+inline void append_int(std::string& out, int value) {
+  char digits[12];
+  int size = 0;
+  do { digits[size++] = char('0' + value % 10); value /= 10; } while (value > 0);
+  while (size > 0) out.push_back(digits[--size]);
+}
+
+// Function that formats the penalty, the time in seconds to get it and the
+// sequence of a solution as they are written in the solution files.
+inline std::string format_solution(const int penalty, const double seconds,
+    const std::vector<int>& solution) {
+
+  // We write the penalty of the solution and the time to get it in seconds
+  // with a precision of a decimal.
+  char header[64];
+  int size = snprintf(header, sizeof(header), "%d %.1f\n", penalty, seconds);
+  std::string out(header, size);
+  // We write the sequence of the solution.
+  out.reserve(out.size() + solution.size() * 8 + 1);
+  for (int i = 0; i < int(solution.size()); ++i) {
+    if (i > 0) out.push_back(' ');
+    append_int(out, solution[i]);
+  }
+  out.push_back('\n');
+  return out;
+}
+
+// Function that writes the penalty, the time in seconds to get it and the
+// sequence of a solution in a file 'path' with a single write. The solution
+// is written in a temporary file that then replaces 'path', so that a reader
+// never finds a file written by half.
+inline void write_solution(const int penalty, const double seconds,
+    const std::vector<int>& solution, const std::string& path) {
+
+  std::string text = format_solution(penalty, seconds, solution);
+  std::string temporary = path + ".tmp";
+  if (FILE* out = fopen(temporary.c_str(), "wb")) {
+    fwrite(text.data(), 1, text.size(), out);
+    fclose(out);
+    std::rename(temporary.c_str(), path.c_str());
+  }
+}
+
+// Function that writes the penalty, the computation time
+// and the sequence of a solution in a file 'argv'.
+inline void write_to_file(const int penalty, const wall_clock::time_point time,
+    const std::vector<int>& solution, const std::string argv) {
+  write_solution(penalty, seconds_since(time), solution, argv);
+}
+
+#endif
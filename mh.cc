@@ -8,217 +8,676 @@
     \_/_____________________/
 */
 #include <iostream>
-#include <fstream>
 #include <vector>
 #include <algorithm>
+#include <random>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <climits>
 #include <math.h>
 #include <time.h>
+#include "instance.h"
+#include "penalty.h"
+#include "writer.h"
+#include "telemetry.h"
+#include "cache.h"
 using namespace std;
 
-// Data structure that sets the model, the number of cars, the number
-// of upgrades and the assignment of improvements of a car model.
-struct car_model {
-  int model;
-  int num_cars;
-  int num_upgrades = 0;
-  vector<bool> upgrades;
-};
+// We define the kinds of moves of the metaheuristic: a swap of two cars of
+// different classes, the shift of a car to another index and the reversal
+// of a block of cars. Shifts and blocks reach as far as the largest window.
+enum move_kind { SWAP, INSERT, REVERSE, MOVE_KINDS };
 
-// Function that writes the penalty, the computation time
-// and the sequence of a solution in a file 'argv'.
-void write_to_file(const int penalty, const clock_t time,
-    const vector<int>& solution, const string argv) {
+// Data structure that sets a move of a kind 'kind' between the indexes 'i'
+// and 'j': the cars that are swapped, the car at 'i' that is put at 'j' or
+// the ends of the block that is reversed.
+struct neighbor_move {
+  int kind, i, j;
+};
 
-  // We set an output stream with a precision of a decimal.
-  ofstream out(argv);
-  out.setf(ios::fixed); out.precision(1);
+// Data structure that keeps a chain of the metaheuristic: its solution with
+// the window table and the penalty of it, its own random number generator,
+// so that chains can run in threads and be reproduced from a seed, and the
+// best solution the chain has found. The moves only change the cars from
+// the index 'first' to 'last'. Each kind of move is picked with a weight
+// that follows the share of its moves accepted lately. A chain may record
+// the trace of its annealing in 'trace'.
+struct chain {
+  vector<int> solution;
+  window_table table;
+  int penalty;
+  mt19937 rng;
+  vector<int> best;
+  int best_penalty;
+  int first = 0, last = 0;
+  int reach = 2;
+  vector<int> segment;
+  double weight[MOVE_KINDS] = {1, 1, 1};
+  int tried[MOVE_KINDS] = {0, 0, 0}, accepted[MOVE_KINDS] = {0, 0, 0};
+  long long moves = 0;
+  annealing_trace* trace = nullptr;
+};
 
-  // We write the penalty of the solution and the time to get it in seconds.
-  double seconds = float(clock() - time)/CLOCKS_PER_SEC;
-  out << penalty << ' ' << seconds << endl;
+// We count the moves scored by all the chains, which are added when a chain
+// is done, to report the throughput of the run.
+atomic<long long> evaluated_moves(0);
 
-  // We write the sequence of the solution.
-  for (int i = 0; i < solution.size(); ++i)
-    (i == 0) ? out << solution[i] : out << ' ' << solution[i];
-  out << endl;
+// We define the number of moves between updates of the weights of the kinds
+// of moves, how much the last ones count and the smallest weight of a kind.
+const int ADAPT_INTERVAL = 1000;
+const double ADAPT_RATE = 0.2;
+const double MIN_WEIGHT = 0.05;
 
-  // We close the file output stream.
-  out.close();
+// Function that picks an index of a car that needs an upgrade in a window
+// with excess, trying a few random windows, or a random index otherwise.
+int violated_index(chain& c, const instance& inst) {
+  uniform_int_distribution<int> index(c.first, c.last);
+  if (inst.improvements == 0) return index(c.rng);
+  uniform_int_distribution<int> station(0, inst.improvements - 1);
+  for (int tries = 0; tries < 8; ++tries) {
+    int s = station(c.rng), k = index(c.rng);
+    if (c.table.counts[s][k] <= inst.resources[s].first) continue;
+    // We pick one of the cars of the window that need the upgrade
+    // and that the moves of the chain can change.
+    int lo = max(c.first, k - inst.resources[s].second + 1);
+    int found = 0, picked = -1;
+    for (int p = lo; p <= k; ++p)
+      if (inst.has(c.solution[p], s) && uniform_int_distribution<int>(0, found++)(c.rng) == 0)
+        picked = p;
+    if (picked >= 0) return picked;
+  }
+  return index(c.rng);
 }
 
-// Function that computes penalties of all windows of a partial
-// solution that reach an index 'k' given a set of parameters.
-int penalties(const vector<int>& solution, int k, int partial_penalty,
-    const vector<car_model>& models, const vector<pair<int, int>>& resources) {
+// Function that picks a move of a chain with the weights of its kinds.
+neighbor_move random_move(chain& c, const instance& inst) {
+  uniform_int_distribution<int> index(c.first, c.last);
+  double total = 0;
+  for (int m = 0; m < MOVE_KINDS; ++m) total += c.weight[m];
+  double r = uniform_real_distribution<double>(0, total)(c.rng);
+  int kind = 0;
+  while (kind + 1 < MOVE_KINDS && r >= c.weight[kind]) r -= c.weight[kind++];
 
-  // We set the penalties we will calculate to
-  // zero and get the number of improvements.
-  int new_penalties = 0;
-  int improvements = models[0].upgrades.size();
-
-  // We calculate the penalties for each station 's'.
-  for (int s = 0; s < improvements; ++s) {
-
-    // We calculate the incomplete windows at the beginning of the sequence.
-    if (k < resources[s].second - 1) {
-      int num_upgrades = 0;
-      for (int p = 0; p <= k; ++p) // We sum the number of upgrades.
-        if (models[solution[p]].upgrades[s]) ++num_upgrades;
-      if (num_upgrades > resources[s].first) // We check and compute penalties.
-        new_penalties += num_upgrades - resources[s].first;
-    }
+  // We swap half the times a car in a window with excess, and always
+  // with a car of another class: we try a few random indexes and then take
+  // the next car of another class, going round the cars of the chain.
+  if (kind == SWAP) {
+    int i = (c.rng() & 1) ? violated_index(c, inst) : index(c.rng);
+    int j = index(c.rng);
+    for (int tries = 1; tries < 8 && c.solution[j] == c.solution[i]; ++tries) j = index(c.rng);
+    for (int step = c.first; step <= c.last && c.solution[j] == c.solution[i]; ++step)
+      j = (j == c.last) ? c.first : j + 1;
+    // If all the cars are of the same class, the move does not change them.
+    if (j == i) j = (i == c.last) ? c.first : i + 1;
+    return {SWAP, i, j};
+  }
+  // We shift a car or reverse a block within the reach of the chain.
+  int i = index(c.rng);
+  int offset = uniform_int_distribution<int>(1, c.reach)(c.rng);
+  int j = (c.rng() & 1) ? i + offset : i - offset;
+  j = max(c.first, min(c.last, j));
+  if (j == i) j = (i == c.first) ? i + 1 : i - 1;
+  return {kind, i, j};
+}
 
-    // We calculate the complete windows that reach the index 'k'.
-    if (k >= resources[s].second - 1) {
-      int num_upgrades = 0;
-      // We sum the number of upgrades.
-      for (int p = k - resources[s].second + 1; p <= k; ++p)
-        if (models[solution[p]].upgrades[s]) ++num_upgrades;
-      if (num_upgrades > resources[s].first) // We check and compute penalties.
-        new_penalties += num_upgrades - resources[s].first;
-    }
+// Function that fills the segment of a chain with the classes that a shift
+// or a reversal 'm' puts between its lowest and its highest index.
+void fill_segment(chain& c, const neighbor_move& m) {
+  int lo = min(m.i, m.j), hi = max(m.i, m.j);
+  c.segment.assign(c.solution.begin() + lo, c.solution.begin() + hi + 1);
+  if (m.kind == REVERSE) reverse(c.segment.begin(), c.segment.end());
+  else if (m.i < m.j) rotate(c.segment.begin(), c.segment.begin() + 1, c.segment.end());
+  else rotate(c.segment.begin(), c.segment.end() - 1, c.segment.end());
+}
 
-    // We calculate the incomplete windows at the end of the sequence.
-    int n = solution.size();
-    if (k == n - 1) {
-      int i = n - resources[s].second + 1;
-      while (i < n - 1) { // We calculate windows up to that of mesure two.
-        int num_upgrades = 0;
-        for (int p = i; p <= k; ++p) // We sum the number of upgrades.
-          if (models[solution[p]].upgrades[s]) ++num_upgrades;
-        if (num_upgrades > resources[s].first) // We check and compute penalties.
-          new_penalties += num_upgrades - resources[s].first;
-        ++i;
-      }
+// Function that updates the weights of the kinds of moves of a chain with
+// the share of their moves accepted since the last update.
+void adapt_weights(chain& c) {
+  for (int m = 0; m < MOVE_KINDS; ++m) {
+    if (c.tried[m] > 0) {
+      double rate = double(c.accepted[m]) / c.tried[m];
+      c.weight[m] = max(MIN_WEIGHT, (1 - ADAPT_RATE) * c.weight[m] + ADAPT_RATE * rate);
     }
+    c.tried[m] = c.accepted[m] = 0;
   }
-  // We sum the new penalties until index 'k' plus the previous penalty.
-  return partial_penalty + new_penalties;
 }
 
-// Function that randomly picks two different indexes of a solution vector.
-vector<int> random_pair(const vector<int>& solution) {
-  int n = solution.size();
-  int i = rand() % n, j = rand() % n;
-  while (i == j) j = rand() % n;
-  return {i, j};
+// Function that builds the window table of the solution of a chain and
+// computes its penalty, which is kept up to date after every accepted move.
+void start_chain(chain& c, const instance& inst) {
+  c.penalty = build_windows(c.solution, c.table, inst);
+  for (int s = 0; s < inst.improvements; ++s)
+    c.reach = max(c.reach, inst.resources[s].second);
+  c.best = c.solution;
+  c.best_penalty = c.penalty;
 }
 
-// We define the parameters and constraints of the simulated annealing function.
-const long double TEMPERATURE = 1000;
-const double TERMINATION_CONDITIONS = 0.001;
-const double ALPHA = 0.9999;
-
-// Function that finds a solution with a random approach
-// by following a metaheuristic given a set of parameters.
-void simulated_annealing(vector<int>& solution, vector<int>& used,
-    vector<car_model>& models, const vector<pair<int,int>>& resources,
-    const string argv, const clock_t time) {
-
+// Function that sets up a chain with a seed 'seed' and a random solution,
+// or the solution 'start' if it is not empty.
+void init_chain(chain& c, const instance& inst, unsigned seed, const vector<int>& start) {
   // We store the size of the solution and the number of classes.
-  int n = solution.size();
-  int classes = models.size();
+  int n = inst.cars;
+  int classes = inst.classes;
+  const vector<car_model>& models = inst.models;
+  vector<int> used(classes, 0);
+  c.solution.assign(n, 0);
+  c.rng.seed(seed);
+  c.first = 0;
+  c.last = n - 1;
+  if (!start.empty()) {
+    c.solution = start;
+    start_chain(c, inst);
+    return;
+  }
 
   // We fill the solution by putting a car of each
   // model one after another while supplies last.
   for (int i = 0; i < n; ++i) {
     // If we have not used all cars of a particular class, we put one.
     if (used[i%classes] < models[i%classes].num_cars) {
-      solution[i] = models[i%classes].model;
+      c.solution[i] = models[i%classes].model;
       ++used[i%classes];
     }
     // Otherwise we put a car of the next model of which we still have stock.
     else {
       int j = i;
       while (used[j%classes] == models[j%classes].num_cars) ++j;
-      solution[i] = models[j%classes].model;
+      c.solution[i] = models[j%classes].model;
       ++used[j%classes];
     }
   }
 
   // We shuffle the cars of the solution to get a random setting.
-  random_shuffle(solution.begin(), solution.end());
+  shuffle(c.solution.begin(), c.solution.end(), c.rng);
+  start_chain(c, inst);
+}
 
-  // We create a neighbor solution and set the penalty
-  // of the solution and the neighbor to zero.
-  vector<int> neighbor(n);
-  int penalty_sol = 0, penalty_nei = 0;
+// Function that computes the change of penalty of a move 'm' of a chain
+// by only visiting the windows around the moved cars.
+int move_delta(chain& c, const neighbor_move& m, const instance& inst) {
+  ++c.moves;
+  if (m.kind == SWAP) return swap_delta(c.solution, m.i, m.j, c.table, inst);
+  fill_segment(c, m);
+  return segment_delta(c.solution, min(m.i, m.j), c.segment, c.table, inst);
+}
 
+// Function that makes a move of a chain at a temperature 'temp' and
+// returns whether the chain has found a better solution than its best.
+bool anneal_step(chain& c, long double temp, const instance& inst) {
+  // We find a neighbor with a random move and compute its change of penalty.
+  neighbor_move m = random_move(c, inst);
+  int lo = min(m.i, m.j);
+  trace_start_evaluation(c.trace);
+  int delta = move_delta(c, m, inst);
+  trace_end_evaluation(c.trace);
+  ++c.tried[m.kind];
+  if (c.tried[SWAP] + c.tried[INSERT] + c.tried[REVERSE] == ADAPT_INTERVAL) adapt_weights(c);
+
+  // A move that leaves the sequence as it is, as the reversal of a block of
+  // cars of the same class, does nothing, so it is not counted as accepted.
+  bool changed = (m.kind == SWAP) ? c.solution[m.i] != c.solution[m.j]
+      : !equal(c.segment.begin(), c.segment.end(), c.solution.begin() + lo);
+  if (!changed) return false;
+
+  // We accept the neighbor if it is better than the solution, and otherwise
+  // with a probability that is decreased with the temperature.
+  if (delta >= 0 && exp(-delta/temp) <= uniform_real_distribution<double>(0, 1)(c.rng))
+    return false;
+  ++c.accepted[m.kind];
+  trace_accept(c.trace);
+  if (m.kind == SWAP) {
+    swap_delta(c.solution, m.i, m.j, c.table, inst, true);
+    swap(c.solution[m.i], c.solution[m.j]);
+  }
+  else {
+    segment_delta(c.solution, lo, c.segment, c.table, inst, true);
+    copy(c.segment.begin(), c.segment.end(), c.solution.begin() + lo);
+  }
+  c.penalty += delta;
+
+  // We keep the solution if it is the best one of the chain.
+  if (c.penalty >= c.best_penalty) return false;
+  c.best = c.solution;
+  c.best_penalty = c.penalty;
+  return true;
+}
+
+// We define the parameters and constraints of the simulated annealing function.
+const long double TEMPERATURE = 1000;
+const double TERMINATION_CONDITIONS = 0.001;
+const double ALPHA = 0.9999;
+const int CLOCK_INTERVAL = 256;
+
+// We define the parameters of the calibration of the cooling: the number of
+// moves it scores and the share of the moves that worsen the solution
+// accepted at the initial temperature. A stalled chain is reheated to a
+// share of the initial temperature, at most a number of times.
+const int CALIBRATION_MOVES = 1000;
+const double TARGET_ACCEPTANCE = 0.8;
+const double REHEAT_FRACTION = 0.5;
+const int MAX_REHEATS = 10;
+
+// Data structure that sets the cooling of an annealing: the initial and the
+// final temperatures, the factor that cools it at every move and the moves without a better solution than the best
+// one of the chain after which it is reheated, or zero to never reheat it.
+struct cooling_schedule {
+  long double initial = TEMPERATURE;
+  long double frozen = TERMINATION_CONDITIONS;
+  long double alpha = ALPHA;
+  long stall = 0;
+};
+
+// Function that calibrates the cooling of a chain by scoring random moves
+// without making them. The initial temperature accepts 'TARGET_ACCEPTANCE'
+// of the moves that worsen the solution, on average. The final temperature
+// is kept, and the factor is set so that the cooling takes as many moves as
+// the fixed one.
+cooling_schedule calibrate(chain& c, const instance& inst) {
+  cooling_schedule schedule;
+  vector<int> uphill;
+  for (int m = 0; m < CALIBRATION_MOVES; ++m) {
+    int delta = move_delta(c, random_move(c, inst), inst);
+    if (delta > 0) uphill.push_back(delta);
+  }
+  if (uphill.empty()) return schedule;
+
+  // We look for the initial temperature by bisection, as the acceptance
+  // grows with the temperature.
+  long double low = 1e-3, high = 1e6;
+  for (int step = 0; step < 100; ++step) {
+    long double middle = sqrt(low * high), acceptance = 0;
+    for (int u = 0; u < int(uphill.size()); ++u) acceptance += exp(-uphill[u] / middle);
+    if (acceptance / uphill.size() < TARGET_ACCEPTANCE) low = middle;
+    else high = middle;
+  }
+  schedule.initial = high;
+  schedule.alpha = exp(log(ALPHA) * log(schedule.frozen / schedule.initial)
+      / log(schedule.frozen / TEMPERATURE));
+  return schedule;
+}
+
+// Function that cools a chain with a schedule 'schedule' and calls
+// 'improved' whenever it finds a better solution than its best.
+template <typename F>
+void anneal(chain& c, const instance& inst, const time_budget& budget,
+    const cooling_schedule& schedule, F improved) {
   // We set an initial temperature value.
-  long double temp = TEMPERATURE;
+  long double start = schedule.initial, temp = start;
+  // We keep the share of the budget used when the cooling started and
+  // the moves since the chain found a better solution than its best.
+  double started = 0;
+  long stalled = 0;
+  int reheats = 0;
   // We iterate based on temperature.
-  while (temp > TERMINATION_CONDITIONS) {
-    // We compute the penalties for the entire solution.
-    penalty_sol = 0;
-    for (int k = 0; k < n; ++k)
-      penalty_sol = penalties(solution, k, penalty_sol, models, resources);
-
-    // We find a neighbor by choosing a random pair
-    // of indexes of the solution and swapping them.
-    neighbor = solution;
-    vector<int> pair = random_pair(solution);
-    swap(neighbor[pair[0]], neighbor[pair[1]]);
-
-    // We compute the penalties for the entire neighbor solution.
-    penalty_nei = 0;
-    for (int k = 0; k < n; ++k)
-      penalty_nei = penalties(neighbor, k, penalty_nei, models, resources);
-
-    // If the neighbor solution is better than the previous
-    // solution, we write it and update the solution.
-    if (penalty_nei < penalty_sol) {
-      write_to_file(penalty_nei, time, neighbor, argv);
-      solution = neighbor;
+  for (long iteration = 0; temp > schedule.frozen; ++iteration) {
+    if (anneal_step(c, temp, inst)) {
+      improved();
+      stalled = 0;
+    }
+    else ++stalled;
+    trace_step(c.trace, temp, c.penalty, c.best_penalty);
+    // If the chain has stalled, we reheat it and start the cooling again.
+    if (schedule.stall > 0 && stalled >= schedule.stall && reheats < MAX_REHEATS
+        && temp < schedule.initial * REHEAT_FRACTION) {
+      start = temp = schedule.initial * REHEAT_FRACTION;
+      started = budget.used();
+      stalled = 0;
+      ++reheats;
+      continue;
+    }
+    // We update the temperature by using a parameter alpha 'α'. With a time
+    // budget, the same cooling from the initial to the final temperature is
+    // instead spread over the budget left, looking at the clock every few
+    // moves.
+    if (budget.limit == 0) temp *= schedule.alpha;
+    else if (iteration % CLOCK_INTERVAL == 0) {
+      if (budget.expired()) break;
+      double progress = (started < 1) ? (budget.used() - started) / (1 - started) : 1;
+      temp = start * pow(schedule.frozen / start, progress);
     }
-    // Otherwise we accept a worsening move with a probability
-    // that is decreased during the search.
-    else
-      if (exp(-(penalty_nei-penalty_sol)/temp) > (double) rand() / (RAND_MAX))
-        solution = neighbor;
+  }
+}
+
+// We define the ladder of temperatures of the parallel tempering, the number
+// of moves between exchanges and the number of moves of every replica, which
+// is the same as a chain of the simulated annealing when there is no budget.
+// A chain that starts from a solution of the cache starts at the hottest
+// temperature of the ladder, as hotter ones would scramble it.
+const long double MIN_TEMPERATURE = 0.1;
+const long double MAX_TEMPERATURE = 10;
+const int EXCHANGE_INTERVAL = 1000;
+const long ITERATIONS = long(log(TERMINATION_CONDITIONS / TEMPERATURE) / log(ALPHA));
 
-    // We update the temperature by using a parameter alpha 'α'.
-    temp *= ALPHA;
+// Function that finds a solution with a random approach
+// by following a metaheuristic given a set of parameters.
+void simulated_annealing(const instance& inst, unsigned seed, bool calibrated,
+    long stall, const vector<int>& start, const time_budget& budget,
+    annealing_trace& trace, solution_writer& out) {
+
+  // We set up a chain with a random or the given solution and write it.
+  chain c;
+  init_chain(c, inst, seed, start);
+  c.trace = &trace;
+  out.post(c.best_penalty, c.best);
+  if (inst.cars < 2) return;
+
+  // We calibrate the cooling on the instance or keep the fixed one, and
+  // start cold from a solution of the cache.
+  cooling_schedule schedule;
+  if (!start.empty()) schedule.initial = MAX_TEMPERATURE;
+  else if (calibrated) schedule = calibrate(c, inst);
+  schedule.stall = stall;
+
+  // If the chain finds a better solution than its best, we write it.
+  anneal(c, inst, budget, schedule, [&]() { out.post(c.best_penalty, c.best); });
+  evaluated_moves += c.moves;
+}
+
+// Data structure that lets a group of threads wait for each other.
+struct barrier {
+  mutex lock;
+  condition_variable all_in;
+  int threads, waiting = 0, round = 0;
+
+  explicit barrier(int threads) : threads(threads) {}
+
+  // Function that waits until all the threads of the group have called it.
+  void wait() {
+    unique_lock<mutex> guard(lock);
+    int current = round;
+    if (++waiting == threads) {
+      waiting = 0;
+      ++round;
+      all_in.notify_all();
+    }
+    else all_in.wait(guard, [&]() { return round != current; });
+  }
+};
+
+// Data structure that keeps the best penalty found by any replica, which is
+// lowered without locks, and a lock to post its solution to the writer.
+struct global_best {
+  atomic<int> penalty;
+  mutex post;
+};
+
+// Function that offers the best solution of a replica. If it is the best one
+// found so far, it lowers the global best penalty and writes the solution,
+// unless a better one has been found in the meantime.
+void offer(global_best& best, const chain& c, solution_writer& out) {
+  int current = best.penalty.load();
+  while (c.best_penalty < current)
+    if (best.penalty.compare_exchange_weak(current, c.best_penalty)) {
+      lock_guard<mutex> guard(best.post);
+      if (best.penalty.load() == c.best_penalty) out.post(c.best_penalty, c.best);
+      return;
+    }
+}
+
+// Function that finds a solution with 'replicas' chains at a ladder of fixed
+// temperatures, each one run by its own thread. Every 'EXCHANGE_INTERVAL'
+// moves, chains at neighbor temperatures exchange their places with the
+// usual probability, so good solutions move to the cold end of the ladder
+// and bad ones are heated to leave their local minima. The chains use the
+// seeds from 'seed' on and the exchanges are decided by a single thread,
+// so a run only depends on the seed and on the number of replicas. With a
+// time budget, the rounds go on until it is over.
+void parallel_tempering(int replicas, const instance& inst, unsigned seed,
+    const vector<int>& start, const time_budget& budget, annealing_trace& trace,
+    solution_writer& out) {
+
+  // We set up the chains and the ladder from the coldest temperature.
+  vector<chain> chains(replicas);
+  vector<long double> temps(replicas);
+  vector<int> at(replicas);
+  for (int r = 0; r < replicas; ++r) {
+    init_chain(chains[r], inst, seed + r, start);
+    temps[r] = MIN_TEMPERATURE * pow(MAX_TEMPERATURE / MIN_TEMPERATURE,
+        (long double) r / max(1, replicas - 1));
+    at[r] = r;
+  }
+  // We trace the first chain as it moves along the ladder.
+  chains[0].trace = &trace;
+  global_best best;
+  best.penalty = INT_MAX;
+  for (int r = 0; r < replicas; ++r) offer(best, chains[r], out);
+  if (inst.cars < 2) return;
+
+  mt19937 exchanges(seed + replicas);
+  long rounds = max(1L, ITERATIONS / EXCHANGE_INTERVAL);
+  bool over = false;
+  barrier sync(replicas);
+  auto replica = [&](int t) {
+    for (long round = 0; !over; ++round) {
+      // We run the chain at the temperature 't' of the ladder.
+      chain& c = chains[at[t]];
+      for (int m = 0; m < EXCHANGE_INTERVAL; ++m) {
+        if (anneal_step(c, temps[t], inst)) offer(best, c, out);
+        trace_step(c.trace, temps[t], c.penalty, c.best_penalty);
+      }
+      sync.wait();
+      // We exchange the chains of neighbor temperatures, from the first
+      // or the second one in alternate rounds, and decide whether to stop.
+      if (t == 0) {
+        over = (budget.limit > 0) ? budget.expired() : round + 1 >= rounds;
+        for (int r = round % 2; r + 1 < replicas; r += 2) {
+          const chain& cold = chains[at[r]];
+          const chain& hot = chains[at[r + 1]];
+          long double p = exp((1 / temps[r] - 1 / temps[r + 1]) * (cold.penalty - hot.penalty));
+          if (p >= 1 || uniform_real_distribution<double>(0, 1)(exchanges) < p)
+            swap(at[r], at[r + 1]);
+        }
+      }
+      sync.wait();
+    }
+  };
+  vector<thread> pool;
+  for (int t = 0; t < replicas; ++t) pool.push_back(thread(replica, t));
+  for (int t = 0; t < replicas; ++t) pool[t].join();
+
+  // We write the best solution of the first chain that has the best penalty,
+  // so that the output of a run does not depend on the order of the threads.
+  int winner = 0;
+  for (int r = 0; r < replicas; ++r) evaluated_moves += chains[r].moves;
+  for (int r = 1; r < replicas; ++r)
+    if (chains[r].best_penalty < chains[winner].best_penalty) winner = r;
+  out.post(chains[winner].best_penalty, chains[winner].best);
+}
+
+// Function that returns a solution where every class is spread evenly along
+// the sequence, by putting at every index the class that is the furthest
+// behind its share of the cars so far. As the cars of a segment stay in it,
+// every segment of the rolling horizons then gets its share of each class.
+vector<int> spread_solution(const instance& inst) {
+  int n = inst.cars;
+  vector<int> solution(n), used(inst.classes, 0);
+  for (int k = 0; k < n; ++k) {
+    int best = -1;
+    double behind = 0;
+    for (int c = 0; c < inst.classes; ++c) {
+      if (used[c] == inst.models[c].num_cars) continue;
+      double share = double(k + 1) * inst.models[c].num_cars / n - used[c];
+      if (best < 0 || share > behind) { best = c; behind = share; }
+    }
+    solution[k] = best;
+    ++used[best];
+  }
+  return solution;
+}
+
+// Function that sets up a chain with a seed 'seed' that only moves the cars
+// of a solution from the index 'lo' to 'hi'. The chain keeps the cars of
+// the largest window around them, which stay fixed, so its moves count the
+// windows across the cuts, and the penalty of the chain only differs from
+// the one of the whole solution by windows that its moves do not change.
+void init_segment(chain& c, const instance& inst, const vector<int>& solution,
+    int lo, int hi, unsigned seed) {
+
+  int n = solution.size();
+  for (int s = 0; s < inst.improvements; ++s)
+    c.reach = max(c.reach, inst.resources[s].second);
+  int from = max(0, lo - c.reach), to = min(n - 1, hi + c.reach);
+  c.solution.assign(solution.begin() + from, solution.begin() + to + 1);
+  c.first = lo - from;
+  c.last = hi - from;
+  c.rng.seed(seed);
+  start_chain(c, inst);
+}
+
+// Function that finds a solution of a long sequence by rolling horizons. It
+// starts from a sequence with the classes spread evenly, which is cut in
+// segments of 'length' cars that are annealed apart with the cars around
+// them fixed, from the initial temperature in the first sweep and from the
+// warmest one of the ladder later on: first the even ones, which are far enough from
+// each other to be annealed at once by 'threads' threads, and then the odd
+// ones. Every sweep moves the cuts by half a segment, so the segments overlap
+// the ones of the sweep before. The segments take their seeds from 'seed' on
+// by their place, so a run does not depend on the number of threads.
+void rolling_horizon(int length, int sweeps, int threads, const instance& inst,
+    unsigned seed, const vector<int>& start, const time_budget& budget, solution_writer& out) {
+
+  // We set up a solution with the classes spread evenly, unless one is
+  // given, and write it.
+  int n = inst.cars;
+  vector<int> solution = start.empty() ? spread_solution(inst) : start;
+  int penalty = sequence_penalty(solution, inst);
+  out.post(penalty, solution);
+  if (n < 2) return;
+
+  // The segments between two segments that are annealed at once
+  // must be as long as the largest window.
+  for (int s = 0; s < inst.improvements; ++s)
+    length = max(length, inst.resources[s].second);
+  // A segment is never longer than the sequence, so the cuts of every
+  // sweep fall inside it.
+  length = min(length, n);
+  int phases = 2 * sweeps;
+  for (int phase = 0; phase < phases && !budget.expired(); ++phase) {
+    // We cut the sequence at the segments of the sweep and take
+    // the even or the odd ones, which have at least two cars.
+    int offset = (phase / 2 % 2) * (length / 2);
+    vector<pair<int, int>> segments;
+    if (offset > 0) segments.push_back({0, offset - 1});
+    for (int lo = offset; lo < n; lo += length) segments.push_back({lo, min(n, lo + length) - 1});
+    vector<int> tasks;
+    for (int e = phase % 2; e < int(segments.size()); e += 2)
+      if (segments[e].second > segments[e].first) tasks.push_back(e);
+
+    // With a time budget, the segments share the time left for the phase.
+    time_budget share;
+    if (budget.limit > 0) {
+      int rounds = (int(tasks.size()) + threads - 1) / max(1, threads);
+      share.limit = (budget.limit - seconds_since(budget.start)) / (phases - phase) / max(1, rounds);
+      share.limit = max(share.limit, 1e-3);
+    }
+
+    // We anneal the segments in a pool of threads, which take them in turns.
+    vector<vector<int>> results(tasks.size());
+    vector<int> gains(tasks.size());
+    atomic<int> next(0);
+    auto segment_worker = [&]() {
+      for (int t = next++; t < int(tasks.size()); t = next++) {
+        // A segment never anneals past the end of the whole budget, and
+        // once it is over the segments left keep their cars.
+        time_budget limit = share;
+        limit.start = wall_clock::now();
+        if (budget.limit > 0) {
+          limit.limit = min(share.limit, budget.limit - seconds_since(budget.start));
+          if (limit.limit <= 0) continue;
+        }
+        const pair<int, int>& segment = segments[tasks[t]];
+        chain c;
+        init_segment(c, inst, solution, segment.first, segment.second,
+            seed + 1 + phase * segments.size() + tasks[t]);
+        int initial = c.penalty;
+        cooling_schedule schedule;
+        if (phase >= 2) schedule.initial = MAX_TEMPERATURE;
+        anneal(c, inst, limit, schedule, []() {});
+        evaluated_moves += c.moves;
+        results[t].assign(c.best.begin() + c.first, c.best.begin() + c.last + 1);
+        gains[t] = initial - c.best_penalty;
+      }
+    };
+    vector<thread> pool;
+    for (int id = 0; id < threads; ++id) pool.push_back(thread(segment_worker));
+    for (int id = 0; id < threads; ++id) pool[id].join();
+
+    // We put the best cars of every segment back in the solution and
+    // write it if it is better.
+    int gain = 0;
+    for (int t = 0; t < int(tasks.size()); ++t) {
+      copy(results[t].begin(), results[t].end(), solution.begin() + segments[tasks[t]].first);
+      gain += gains[t];
+    }
+    if (gain > 0) {
+      penalty -= gain;
+      out.post(penalty, solution);
+    }
   }
 }
 
 int main(int argc, char** argv) {
-  // We create an input stream class to operate on files.
-  ifstream in(argv[1]);
-
-  // We read the number of cars 'C', improvements 'M' and classes 'K'.
-  int cars, improvements, classes;
-  in >> cars >> improvements >> classes;
-  // We read the number of cars 'ce' which can require an
-  // improvement out of a window of 'ne' consecutive cars.
-  vector<pair<int,int>> resources(improvements);
-  for (int i = 0; i < improvements; ++i) in >> resources[i].first;
-  for (int i = 0; i < improvements; ++i) in >> resources[i].second;
-  // We read the number of cars of each class
-  // and whether they need or not an upgrade.
-  vector<car_model> models(classes);
-  bool upgrade;
-  for (int i = 0; i < classes; ++i) {
-    in >> models[i].model >> models[i].num_cars;
-    for (int j = 0; j < improvements; ++j) {
-      in >> upgrade;
-      if (upgrade) ++models[i].num_upgrades;
-      models[i].upgrades.push_back(upgrade);
-  } }
-
-  // We close the file input stream.
-  in.close();
-
-  // We get the current time before executing
-  // the metaheuristic of the solution.
-  clock_t timer;
-  timer = clock();
-  // We set a seed for the random number generator.
-  srand(time(NULL));
-
-  // We create a void solution that will be filled and a
-  // vector that will keep track of the used car classes.
-  vector<int> solution(cars);
-  vector<int> used(classes, 0);
-  // We find a solution by following the simulated annealing metaheuristic.
-  simulated_annealing(solution, used, models, resources, argv[2], timer);
+  // We read the instance of the problem.
+  instance inst = read_instance(argv[1]);
+  // We read the seed of the random number generators ('--seed') and the
+  // number of replicas of the parallel tempering ('--replicas'), where
+  // zero means one per core and one means a single simulated annealing.
+  unsigned seed = get_option(argc, argv, "--seed", (unsigned) time(NULL));
+  int replicas = get_option(argc, argv, "--replicas", 1);
+  if (replicas == 0) replicas = max(1u, thread::hardware_concurrency());
+  // We read the length of the segments of the rolling horizons ('--horizon',
+  // zero to anneal the whole sequence), the number of sweeps ('--sweeps')
+  // and the number of threads that anneal the segments ('--threads').
+  int horizon = get_option(argc, argv, "--horizon", 0);
+  int sweeps = get_option(argc, argv, "--sweeps", 2);
+  int threads = max(1, get_option(argc, argv, "--threads", 1));
+  // We read whether the cooling of the simulated annealing is calibrated
+  // on the instance ('--calibrate', 1 by default) and the moves without improvement after
+  // which it is reheated ('--stall', 0 to never do it).
+  bool calibrated = get_option(argc, argv, "--calibrate", 1) != 0;
+  long stall = get_option(argc, argv, "--stall", 0L);
+  // We read the folder of the cache of solutions ('--cache', none by
+  // default), and start from the solution of the cache closest to the
+  // instance if there is one.
+  string cache = get_option(argc, argv, "--cache", string());
+  vector<int> start;
+  int cached_penalty;
+  if (!warm_start(cache, inst, start, cached_penalty)) start.clear();
+
+  // We get the current time before executing the metaheuristic of the
+  // solution and read its time budget in seconds ('--time-limit').
+  wall_clock::time_point timer;
+  timer = wall_clock::now();
+  time_budget budget = read_budget(argc, argv, timer);
+  // In a build with telemetry, we record the trace of the simulated
+  // annealing, or of the first chain of the parallel tempering, in the file
+  // given with '--trace'. The segments of the rolling horizons are annealed
+  // by many chains at once, so they cannot be traced.
+  annealing_trace trace;
+  string trace_path = get_option(argc, argv, "--trace", string());
+  if (!trace_path.empty() && horizon > 0) {
+    cerr << "--trace cannot be used with --horizon" << endl;
+    return 1;
+  }
+  if (!trace_path.empty()) trace.open(trace_path, timer);
+
+  // We find a solution by following the simulated annealing metaheuristic,
+  // by rolling horizons if the segments are set, or the parallel tempering
+  // if there are several replicas. The best solutions are written in the
+  // background as they are found, and the last one is kept in the cache.
+  {
+    solution_writer out(argv[2], timer);
+    if (horizon > 0) rolling_horizon(horizon, sweeps, threads, inst, seed, start, budget, out);
+    else if (replicas == 1)
+      simulated_annealing(inst, seed, calibrated, stall, start, budget, trace, out);
+    else parallel_tempering(replicas, inst, seed, start, budget, trace, out);
+  }
+  store_solution_file(cache, inst, argv[2]);
+
+  // We report the moves scored and how many were scored every second.
+  double seconds = seconds_since(timer);
+  cerr << "evaluated " << evaluated_moves << " moves in " << seconds << " s, "
+      << (long long) (evaluated_moves / max(seconds, 1e-9)) << " moves/s" << endl;
 }
@@ -0,0 +1,634 @@
+/*
+  ________________________
+ /\                       \
+ \_|    PENALTY ENGINE    |
+   |                      |
+   |       penalty.h      |
+   |   ___________________|_
+    \_/_____________________/
+*/
+#ifndef PENALTY_H
+#define PENALTY_H
+
+#include <algorithm>
+#include <vector>
+#include <climits>
+#include <stdint.h>
+#include "instance.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PENALTY_AVX2 1
+#endif
+
+// Function that returns the penalty of a window with 'num_upgrades'
+// upgrades for a station that allows 'capacity' of them.
+inline int excess(int num_upgrades, int capacity) {
+  return (num_upgrades > capacity) ? num_upgrades - capacity : 0;
+}
+
+// Function that returns the first index of the incomplete
+// windows at the end of a sequence of size 'n'.
+inline int tail_start(int n, int window) {
+  return std::max(0, n - window + 1);
+}
+
+struct sequence_bits;
+struct window_group;
+
+// Type of the kernels that compute the penalties of the windows that end at
+// an index for a group of stations with the same window.
+typedef int (*window_kernel)(const sequence_bits& bits, const window_group& group, int k);
+
+// Data structure that keeps the stations with the same window 'window',
+// their capacities and the kernel that computes their penalties.
+struct window_group {
+  int window;
+  std::vector<int> stations, capacities;
+  window_kernel kernel;
+};
+
+// Data structure that stores a sequence in a station-major layout: one
+// row of 'words' words per station where the bit 'p' of the row 's' is
+// set if the car at the index 'p' needs an upgrade in the station 's'.
+// 'groups' keeps the stations grouped by their window.
+struct sequence_bits {
+  int n = 0, words = 0;
+  std::vector<uint64_t> rows;
+  std::vector<window_group> groups;
+
+  // Function that returns the row of bits of a station 's'.
+  uint64_t* row(int s) { return &rows[s * words]; }
+  const uint64_t* row(int s) const { return &rows[s * words]; }
+};
+
+inline window_kernel select_kernel(int window);
+
+// Function that sets up an empty sequence of size 'n', grouping the stations
+// by their window and choosing the kernel of every group.
+inline void init_bits(sequence_bits& bits, const instance& inst, int n) {
+  bits.n = n;
+  bits.words = (n + 63) / 64;
+  bits.rows.assign(inst.improvements * bits.words, 0);
+  bits.groups.clear();
+  for (int s = 0; s < inst.improvements; ++s) {
+    int window = inst.resources[s].second, g = 0;
+    while (g < int(bits.groups.size()) && bits.groups[g].window != window) ++g;
+    if (g == int(bits.groups.size())) {
+      window_group group;
+      group.window = window;
+      group.kernel = select_kernel(window);
+      bits.groups.push_back(group);
+    }
+    bits.groups[g].stations.push_back(s);
+    bits.groups[g].capacities.push_back(inst.resources[s].first);
+  }
+}
+
+// Function that puts a car of a class 'c' at the index 'k' of the sequence.
+inline void place(sequence_bits& bits, const instance& inst, int k, int c) {
+  uint64_t bit = uint64_t(1) << (k & 63);
+  int word = k >> 6;
+  const uint64_t* mask = inst.mask(c);
+  for (int s = 0; s < inst.improvements; ++s) {
+    uint64_t& w = bits.rows[s * bits.words + word];
+    // We clear the previous car and set the bit if the class needs it.
+    uint64_t needs = (mask[s >> 6] >> (s & 63)) & 1;
+    w = (w & ~bit) | ((uint64_t(0) - needs) & bit);
+  }
+}
+
+// Function that fills the rows of bits of a whole solution.
+inline void fill_bits(sequence_bits& bits, const std::vector<int>& solution,
+    const instance& inst) {
+  init_bits(bits, inst, solution.size());
+  for (int k = 0; k < int(solution.size()); ++k) place(bits, inst, k, solution[k]);
+}
+
+// Function that counts the upgrades of a station 's' between the indexes
+// 'lo' and 'hi' (both included) with a popcount over the masked words.
+inline int window_count(const sequence_bits& bits, int s, int lo, int hi) {
+  const uint64_t* row = bits.row(s);
+  int first = lo >> 6, last = hi >> 6;
+  uint64_t low = ~uint64_t(0) << (lo & 63);
+  uint64_t high = ~uint64_t(0) >> (63 - (hi & 63));
+  if (first == last) return __builtin_popcountll(row[first] & low & high);
+  int num_upgrades = __builtin_popcountll(row[first] & low);
+  for (int w = first + 1; w < last; ++w) num_upgrades += __builtin_popcountll(row[w]);
+  return num_upgrades + __builtin_popcountll(row[last] & high);
+}
+
+// Function that computes the penalties of the windows that end at an index
+// 'k' for a group of stations with the window 'window'. The words and masks
+// of the window are computed once for all the stations of the group, and a
+// window of at most 64 cars never spans more than two words. It is always
+// inlined in the kernels, so it takes their window and their instructions.
+__attribute__((always_inline))
+inline int group_penalties(const sequence_bits& bits, const window_group& group, int k,
+    int window) {
+
+  int lo = std::max(0, k - window + 1);
+  int first = lo >> 6, last = k >> 6;
+  uint64_t low = ~uint64_t(0) << (lo & 63);
+  uint64_t high = ~uint64_t(0) >> (63 - (k & 63));
+  const uint64_t* rows = bits.rows.data();
+  const int* stations = group.stations.data();
+  const int* capacities = group.capacities.data();
+  int size = group.stations.size(), words = bits.words, penalty = 0;
+  if (first == last) {
+    uint64_t mask = low & high;
+    for (int g = 0; g < size; ++g)
+      penalty += excess(__builtin_popcountll(rows[stations[g] * words + first] & mask),
+          capacities[g]);
+  }
+  else if (window <= 64 || last == first + 1) {
+    for (int g = 0; g < size; ++g) {
+      const uint64_t* row = rows + stations[g] * words;
+      penalty += excess(__builtin_popcountll(row[first] & low)
+          + __builtin_popcountll(row[last] & high), capacities[g]);
+    }
+  }
+  else
+    for (int g = 0; g < size; ++g)
+      penalty += excess(window_count(bits, stations[g], lo, k), capacities[g]);
+  return penalty;
+}
+
+// Functions that are the kernels of a group with a window 'W' known at
+// compile time, so the compiler folds the window into the computation of
+// the words, built for any processor and for the ones with the 'popcnt'
+// instruction, which otherwise is a call to a library function.
+template <int W>
+int fixed_window_kernel(const sequence_bits& bits, const window_group& group, int k) {
+  return group_penalties(bits, group, k, W);
+}
+
+#ifdef PENALTY_AVX2
+template <int W>
+__attribute__((target("popcnt")))
+int fixed_window_kernel_popcnt(const sequence_bits& bits, const window_group& group, int k) {
+  return group_penalties(bits, group, k, W);
+}
+#endif
+
+// Functions that are the kernels of a group with any window.
+inline int generic_window_kernel(const sequence_bits& bits, const window_group& group, int k) {
+  return group_penalties(bits, group, k, group.window);
+}
+
+#ifdef PENALTY_AVX2
+__attribute__((target("popcnt")))
+inline int generic_window_kernel_popcnt(const sequence_bits& bits, const window_group& group,
+    int k) {
+  return group_penalties(bits, group, k, group.window);
+}
+#endif
+
+// We define the largest window with a kernel of its own. The instances use
+// windows from 2 to about 30 cars, and the larger ones take the generic one.
+const int MAX_FIXED_WINDOW = 32;
+
+// Data structure that keeps the dispatch table of the kernels by window,
+// which is filled at compile time from 'MAX_FIXED_WINDOW' down to one.
+template <int W>
+struct kernel_table {
+  static void fill(window_kernel* table, bool popcnt) {
+#ifdef PENALTY_AVX2
+    table[W] = popcnt ? &fixed_window_kernel_popcnt<W> : &fixed_window_kernel<W>;
+#else
+    table[W] = &fixed_window_kernel<W>;
+#endif
+    kernel_table<W - 1>::fill(table, popcnt);
+  }
+};
+template <>
+struct kernel_table<0> {
+  static void fill(window_kernel*, bool) {}
+};
+
+// Function that tells whether the processor has the 'popcnt' instruction.
+inline bool has_popcnt() {
+#ifdef PENALTY_AVX2
+  static const bool supported = __builtin_cpu_supports("popcnt");
+  return supported;
+#else
+  return false;
+#endif
+}
+
+// Function that returns the kernel of the stations with a window 'window'
+// for the processor that runs the program.
+inline window_kernel select_kernel(int window) {
+  struct dispatch {
+    window_kernel table[MAX_FIXED_WINDOW + 1];
+    window_kernel generic;
+    dispatch() {
+      kernel_table<MAX_FIXED_WINDOW>::fill(table, has_popcnt());
+#ifdef PENALTY_AVX2
+      generic = has_popcnt() ? &generic_window_kernel_popcnt : &generic_window_kernel;
+#else
+      generic = &generic_window_kernel;
+#endif
+    }
+  };
+  static const dispatch kernels;
+  return (window <= MAX_FIXED_WINDOW) ? kernels.table[window] : kernels.generic;
+}
+
+// Function that computes penalties of all windows of a partial
+// solution that reach an index 'k' given a set of parameters.
+inline int penalties(const sequence_bits& bits, int k, int partial_penalty,
+    const instance& inst) {
+
+  // We calculate the window that reaches the index 'k' of every station
+  // with the kernel of its group.
+  int new_penalties = 0;
+  for (int g = 0; g < int(bits.groups.size()); ++g)
+    new_penalties += bits.groups[g].kernel(bits, bits.groups[g], k);
+
+  // We calculate the incomplete windows at the end of the sequence.
+  int n = bits.n;
+  if (k == n - 1)
+    for (int s = 0; s < inst.improvements; ++s) {
+      int capacity = inst.resources[s].first, window = inst.resources[s].second;
+      for (int i = tail_start(n, window); i < n - 1; ++i)
+        new_penalties += excess(window_count(bits, s, i, k), capacity);
+    }
+  // We sum the new penalties until index 'k' plus the previous penalty.
+  return partial_penalty + new_penalties;
+}
+
+// Function that computes the same penalties as 'penalties' station by
+// station, reading every window at run time, as the generic reference of
+// the kernels.
+inline int station_penalties(const sequence_bits& bits, int k, int partial_penalty,
+    const instance& inst) {
+
+  // We set the penalties we will calculate to zero.
+  int new_penalties = 0;
+  int n = bits.n;
+
+  // We calculate the penalties for each station 's'.
+  for (int s = 0; s < inst.improvements; ++s) {
+    int capacity = inst.resources[s].first, window = inst.resources[s].second;
+
+    // We calculate the window that reaches the index 'k', which
+    // is incomplete at the beginning of the sequence.
+    new_penalties += excess(window_count(bits, s, std::max(0, k - window + 1), k), capacity);
+
+    // We calculate the incomplete windows at the end of the sequence.
+    if (k == n - 1)
+      for (int i = tail_start(n, window); i < n - 1; ++i)
+        new_penalties += excess(window_count(bits, s, i, k), capacity);
+  }
+  // We sum the new penalties until index 'k' plus the previous penalty.
+  return partial_penalty + new_penalties;
+}
+
+// Data structure that keeps, for every station, the number of upgrades
+// inside each window of the sequence. Windows are stored in the same order
+// 'penalties' visits them: first the window that ends at every index 'k'
+// (incomplete at the beginning) and then the incomplete windows at the end.
+// 'change' and 'stations' are scratch rows for the changes made by a move.
+struct window_table {
+  std::vector<std::vector<int>> counts;
+  std::vector<int> change;
+  std::vector<uint64_t> stations;
+};
+
+// Function that fills the window table of a solution with a sliding
+// count for every station and returns the penalty of the solution.
+inline int build_windows(const std::vector<int>& solution, window_table& table,
+    const instance& inst) {
+
+  int n = solution.size();
+  int penalty = 0;
+  table.counts.assign(inst.improvements, std::vector<int>());
+
+  for (int s = 0; s < inst.improvements; ++s) {
+    int capacity = inst.resources[s].first, window = inst.resources[s].second;
+    int first = tail_start(n, window);
+    std::vector<int>& counts = table.counts[s];
+    counts.assign(n + std::max(0, n - 1 - first), 0);
+
+    // We slide the window that ends at every index 'k'.
+    int num_upgrades = 0;
+    for (int k = 0; k < n; ++k) {
+      if (inst.has(solution[k], s)) ++num_upgrades;
+      if (k >= window && inst.has(solution[k - window], s)) --num_upgrades;
+      counts[k] = num_upgrades;
+      penalty += excess(num_upgrades, capacity);
+    }
+
+    // We shrink the last window from the left to get the incomplete ones.
+    num_upgrades = 0;
+    for (int p = first; p < n; ++p)
+      if (inst.has(solution[p], s)) ++num_upgrades;
+    for (int i = first; i < n - 1; ++i) {
+      counts[n + i - first] = num_upgrades;
+      penalty += excess(num_upgrades, capacity);
+      if (inst.has(solution[i], s)) --num_upgrades;
+    }
+  }
+  return penalty;
+}
+
+// Function that visits the windows of a station that contain the index 'i'
+// but not 'j' (i < j) and the ones that contain 'j' but not 'i', adding
+// 'd' to the first ones and '-d' to the second ones. If 'apply' is set,
+// the counts are updated, otherwise only the change of penalty is returned.
+inline int shift_windows(std::vector<int>& counts, int n, int i, int j, int d,
+    int capacity, int window, bool apply) {
+
+  int delta = 0;
+  // We visit the windows that end at an index 'k' and contain only 'i'.
+  for (int k = i, last = std::min(std::min(i + window - 1, j - 1), n - 1); k <= last; ++k) {
+    delta += excess(counts[k] + d, capacity) - excess(counts[k], capacity);
+    if (apply) counts[k] += d;
+  }
+  // We visit the windows that end at an index 'k' and contain only 'j'.
+  for (int k = std::max(j, i + window), last = std::min(j + window - 1, n - 1); k <= last; ++k) {
+    delta += excess(counts[k] - d, capacity) - excess(counts[k], capacity);
+    if (apply) counts[k] -= d;
+  }
+  // We visit the incomplete windows at the end that contain only 'j'.
+  int first = tail_start(n, window);
+  for (int t = std::max(i + 1, first), last = std::min(j, n - 2); t <= last; ++t) {
+    int& c = counts[n + t - first];
+    delta += excess(c - d, capacity) - excess(c, capacity);
+    if (apply) c -= d;
+  }
+  return delta;
+}
+
+// Function that computes the change of penalty of swapping the indexes
+// 'i' and 'j' of a solution by only visiting the windows around them.
+// If 'apply' is set, the window table is updated to the swapped solution.
+inline int swap_delta(const std::vector<int>& solution, int i, int j,
+    window_table& table, const instance& inst, bool apply = false) {
+
+  if (i > j) std::swap(i, j);
+  int out = solution[i], in = solution[j];
+  int n = solution.size();
+  int delta = 0;
+
+  // We only visit the stations where the two car models differ,
+  // which are the bits set in the xor of their station masks.
+  const uint64_t* mask_out = inst.mask(out);
+  const uint64_t* mask_in = inst.mask(in);
+  for (int w = 0; w < inst.mask_words; ++w)
+    for (uint64_t diff = mask_out[w] ^ mask_in[w]; diff; diff &= diff - 1) {
+      int s = w * 64 + __builtin_ctzll(diff);
+      int d = inst.has(in, s) ? 1 : -1;
+      delta += shift_windows(table.counts[s], n, i, j, d,
+          inst.resources[s].first, inst.resources[s].second, apply);
+    }
+  return delta;
+}
+
+// Function that computes the change of penalty of replacing the indexes from
+// 'lo' on of a solution with the classes of 'segment', which must have the
+// same cars, by only visiting the windows that overlap the segment. If
+// 'apply' is set, the window table is updated to the new solution.
+inline int segment_delta(const std::vector<int>& solution, int lo,
+    const std::vector<int>& segment, window_table& table, const instance& inst,
+    bool apply = false) {
+
+  int n = solution.size(), size = segment.size(), hi = lo + size - 1;
+  int delta = 0;
+  // We only visit the stations where some index of the segment changes.
+  std::vector<uint64_t>& stations = table.stations;
+  stations.assign(inst.mask_words, 0);
+  for (int p = 0; p < size; ++p)
+    if (segment[p] != solution[lo + p]) {
+      const uint64_t* mask_old = inst.mask(solution[lo + p]);
+      const uint64_t* mask_new = inst.mask(segment[p]);
+      for (int w = 0; w < inst.mask_words; ++w) stations[w] |= mask_old[w] ^ mask_new[w];
+    }
+
+  std::vector<int>& change = table.change;
+  change.assign(size + 1, 0);
+  for (int w = 0; w < inst.mask_words; ++w)
+    for (uint64_t bits = stations[w]; bits; bits &= bits - 1) {
+      int s = w * 64 + __builtin_ctzll(bits);
+      int capacity = inst.resources[s].first, window = inst.resources[s].second;
+      std::vector<int>& counts = table.counts[s];
+      // We sum the changes of upgrades of the segment from its beginning,
+      // so that the change of a window is the difference of two sums.
+      for (int p = 0; p < size; ++p)
+        change[p + 1] = change[p] + inst.has(segment[p], s) - inst.has(solution[lo + p], s);
+      // We visit the windows that end at an index 'k' and overlap the segment.
+      for (int k = lo, last = std::min(hi + window - 1, n - 1); k <= last; ++k) {
+        int d = change[std::min(hi, k) - lo + 1] - change[std::max(lo, k - window + 1) - lo];
+        delta += excess(counts[k] + d, capacity) - excess(counts[k], capacity);
+        if (apply) counts[k] += d;
+      }
+      // We visit the incomplete windows at the end that overlap the segment.
+      int first = tail_start(n, window);
+      for (int t = std::max(first, lo), last = std::min(hi, n - 2); t <= last; ++t) {
+        int& c = counts[n + t - first];
+        int d = change[size] - change[t - lo];
+        delta += excess(c + d, capacity) - excess(c, capacity);
+        if (apply) c += d;
+      }
+    }
+  return delta;
+}
+
+// Data structure that gives a lower bound of the penalty of the cars that are
+// still to be placed. For every station it keeps the upgrades still demanded
+// by the unused cars and, for every number of indexes 'x', the most upgrades
+// that 'x' indexes at the end of the sequence can hold without penalty when
+// they are split in full windows and a last incomplete window.
+struct suffix_bound {
+  std::vector<int> demand;
+  std::vector<std::vector<int>> capacity;
+};
+
+// Function that sets up the lower bound for an empty sequence.
+inline void init_bound(suffix_bound& bound, const instance& inst) {
+  bound.demand.assign(inst.improvements, 0);
+  bound.capacity.assign(inst.improvements, std::vector<int>(inst.cars + 1));
+  for (int s = 0; s < inst.improvements; ++s) {
+    int capacity = inst.resources[s].first, window = inst.resources[s].second;
+    for (int c = 0; c < inst.classes; ++c)
+      if (inst.has(c, s)) bound.demand[s] += inst.models[c].num_cars;
+    // The last incomplete window is not counted when it only has one index.
+    for (int x = 0; x <= inst.cars; ++x) {
+      int rest = x % window;
+      bound.capacity[s][x] = x / window * capacity + ((rest < 2) ? rest : std::min(rest, capacity));
+    }
+  }
+}
+
+// Function that updates the demand of the stations when a car of a class
+// 'c' is placed ('d' = -1) or removed ('d' = 1) from the sequence.
+inline void update_demand(suffix_bound& bound, const instance& inst, int c, int d) {
+  const uint64_t* mask = inst.mask(c);
+  for (int w = 0; w < inst.mask_words; ++w)
+    for (uint64_t bits = mask[w]; bits; bits &= bits - 1)
+      bound.demand[w * 64 + __builtin_ctzll(bits)] += d;
+}
+
+// Function that computes a lower bound of the penalty of the windows that
+// end after the first 'placed' indexes of the sequence. In every station,
+// the indexes left are split in disjoint windows that are all counted: the
+// window that ends at the index 'placed + j - 1' (its upgrades among the
+// placed cars reduce what its 'j' free indexes can hold), followed by full
+// windows and a last incomplete one. Any upgrade demanded beyond what these
+// windows can hold is a penalty, and we keep the best split 'j'.
+inline int suffix_penalty_bound(const suffix_bound& bound, const instance& inst,
+    const sequence_bits& bits, int placed) {
+
+  int m = bits.n - placed;
+  int penalty = 0;
+  for (int s = 0; s < inst.improvements; ++s) {
+    if (bound.demand[s] == 0) continue;
+    int capacity = inst.resources[s].first, window = inst.resources[s].second;
+    const uint64_t* row = bits.row(s);
+    // We count the placed upgrades inside the window that ends at 'placed'.
+    int lo = placed + 1 - window;
+    int num_upgrades = (placed > 0) ? window_count(bits, s, std::max(0, lo), placed - 1) : 0;
+    int best = INT_MAX;
+    for (int j = 1; j <= std::min(window, m); ++j, ++lo) {
+      int room = std::min(j, std::max(0, capacity - num_upgrades));
+      best = std::min(best, room + bound.capacity[s][m - j]);
+      // We slide the window one index, leaving the placed car at 'lo'.
+      if (lo >= 0 && ((row[lo >> 6] >> (lo & 63)) & 1)) --num_upgrades;
+    }
+    if (m > 0 && bound.demand[s] > best) penalty += bound.demand[s] - best;
+  }
+  return penalty;
+}
+
+// Data structure that keeps the buffers of the full-sequence evaluator, so
+// they are not allocated again every time a sequence is scored.
+struct sequence_scratch {
+  std::vector<int> flag, prefix;
+};
+
+// Function that computes the penalty of all windows of a station in one pass.
+// 'flag' tells whether each class needs the upgrade, and 'prefix' gets the
+// prefix sum of the upgrades padded with 'window' zeros in front, so that
+// 'prefix[window + p]' counts the upgrades before the index 'p' and the
+// window that ends at 'k' has 'prefix[window + k + 1] - prefix[k + 1]' of them.
+inline int station_penalty_scalar(const int* solution, int n, const int* flag,
+    int* prefix, int capacity, int window) {
+
+  // We compute the padded prefix sum of the upgrades.
+  std::fill(prefix, prefix + window + 1, 0);
+  int* sum = prefix + window;
+  for (int p = 0; p < n; ++p) sum[p + 1] = sum[p] + flag[solution[p]];
+
+  // We calculate the window that ends at every index 'k', which
+  // is incomplete at the beginning of the sequence.
+  int penalty = 0;
+  for (int k = 0; k < n; ++k) penalty += excess(sum[k + 1] - prefix[k + 1], capacity);
+  // We calculate the incomplete windows at the end of the sequence.
+  for (int i = tail_start(n, window); i < n - 1; ++i)
+    penalty += excess(sum[n] - sum[i], capacity);
+  return penalty;
+}
+
+#ifdef PENALTY_AVX2
+// Function that computes the same penalty as 'station_penalty_scalar' with
+// AVX2: the flags of eight cars are gathered at once, their prefix sum is
+// computed in register and every window excess is taken eight at a time.
+__attribute__((target("avx2")))
+inline int station_penalty_avx2(const int* solution, int n, const int* flag,
+    int* prefix, int capacity, int window) {
+
+  // We compute the padded prefix sum of the upgrades, eight cars at a time.
+  std::fill(prefix, prefix + window + 1, 0);
+  int* sum = prefix + window;
+  __m256i carry = _mm256_setzero_si256();
+  int p = 0;
+  for (; p + 8 <= n; p += 8) {
+    __m256i x = _mm256_i32gather_epi32(flag,
+        _mm256_loadu_si256((const __m256i*)(solution + p)), 4);
+    // We scan each half and then add the total of the low half to the high one.
+    x = _mm256_add_epi32(x, _mm256_slli_si256(x, 4));
+    x = _mm256_add_epi32(x, _mm256_slli_si256(x, 8));
+    __m256i low = _mm256_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+    x = _mm256_add_epi32(x, _mm256_permute2x128_si256(low, low, 0x08));
+    x = _mm256_add_epi32(x, carry);
+    _mm256_storeu_si256((__m256i*)(sum + p + 1), x);
+    carry = _mm256_permutevar8x32_epi32(x, _mm256_set1_epi32(7));
+  }
+  for (; p < n; ++p) sum[p + 1] = sum[p] + flag[solution[p]];
+
+  // We calculate the window that ends at every index 'k'.
+  __m256i zero = _mm256_setzero_si256();
+  __m256i cap = _mm256_set1_epi32(capacity);
+  __m256i acc = zero;
+  int penalty = 0, k = 0;
+  for (; k + 8 <= n; k += 8) {
+    __m256i d = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(sum + k + 1)),
+        _mm256_loadu_si256((const __m256i*)(prefix + k + 1)));
+    acc = _mm256_add_epi32(acc, _mm256_max_epi32(_mm256_sub_epi32(d, cap), zero));
+  }
+  for (; k < n; ++k) penalty += excess(sum[k + 1] - prefix[k + 1], capacity);
+
+  // We calculate the incomplete windows at the end of the sequence.
+  __m256i total = _mm256_set1_epi32(sum[n]);
+  int i = tail_start(n, window);
+  for (; i + 8 <= n - 1; i += 8) {
+    __m256i d = _mm256_sub_epi32(total, _mm256_loadu_si256((const __m256i*)(sum + i)));
+    acc = _mm256_add_epi32(acc, _mm256_max_epi32(_mm256_sub_epi32(d, cap), zero));
+  }
+  for (; i < n - 1; ++i) penalty += excess(sum[n] - sum[i], capacity);
+
+  // We add up the eight partial penalties.
+  __m128i half = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+  half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+  half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+  return penalty + _mm_cvtsi128_si32(half);
+}
+#endif
+
+// Function that tells whether the processor can run the AVX2 evaluator.
+inline bool has_avx2() {
+#ifdef PENALTY_AVX2
+  static const bool supported = __builtin_cpu_supports("avx2");
+  return supported;
+#else
+  return false;
+#endif
+}
+
+// Function that computes the penalty of a complete solution station by
+// station with the full-sequence evaluator, which is the same value as
+// calling 'penalties' for every index. Unless 'vectorized' is unset, the
+// AVX2 evaluator is used when the processor supports it.
+inline int sequence_penalty(const std::vector<int>& solution, const instance& inst,
+    sequence_scratch& scratch, bool vectorized = true) {
+
+  int n = solution.size();
+  int penalty = 0;
+  scratch.flag.resize(inst.classes);
+
+  for (int s = 0; s < inst.improvements; ++s) {
+    int capacity = inst.resources[s].first, window = inst.resources[s].second;
+    // We get whether each class needs the upgrade of the station.
+    for (int c = 0; c < inst.classes; ++c) scratch.flag[c] = inst.has(c, s);
+    scratch.prefix.resize(window + n + 8);
+#ifdef PENALTY_AVX2
+    if (vectorized && has_avx2()) {
+      penalty += station_penalty_avx2(solution.data(), n, scratch.flag.data(),
+          scratch.prefix.data(), capacity, window);
+      continue;
+    }
+#endif
+    penalty += station_penalty_scalar(solution.data(), n, scratch.flag.data(),
+        scratch.prefix.data(), capacity, window);
+  }
+  return penalty;
+}
+
+// Function that computes the penalty of a complete solution.
+inline int sequence_penalty(const std::vector<int>& solution, const instance& inst) {
+  sequence_scratch scratch;
+  return sequence_penalty(solution, inst, scratch);
+}
+
+#endif
@@ -0,0 +1,366 @@
+/*
+  ________________________
+ /\                       \
+ \_|    SOLVER SERVICE    |
+   |                      |
+   |      service.cc      |
+   |   ___________________|_
+    \_/_____________________/
+*/
+#include <iostream>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "instance.h"
+#include "penalty.h"
+#include "constructive.h"
+#include "tabu.h"
+using namespace std;
+
+// Data structure that keeps a client of the service: the descriptors it is
+// read from and answered to, and the lock of its answers, so that the lines
+// of two jobs are never mixed. The descriptors of a socket are closed when
+// the last job of the client is answered.
+struct connection {
+  int in, out;
+  bool owned;
+  mutex lock;
+
+  connection(int in, int out, bool owned) : in(in), out(out), owned(owned) {}
+  ~connection() { if (owned) close(in); }
+
+  // Function that writes a whole answer 'text'.
+  void answer(const string& text) {
+    lock_guard<mutex> guard(lock);
+    for (size_t done = 0; done < text.size(); ) {
+      ssize_t size = write(out, text.data() + done, text.size() - done);
+      if (size < 0 && errno == EINTR) continue;
+      if (size <= 0) return;
+      done += size;
+    }
+  }
+};
+
+// Data structure that keeps a job of the service: the client that sent it,
+// its number for the client, the path of its instance or the instance
+// itself, the words of its request (as a command line, for its options) and
+// the time it was queued.
+struct job {
+  shared_ptr<connection> client;
+  long long id;
+  string path, text;
+  vector<string> words;
+  wall_clock::time_point queued;
+};
+
+// Data structure that keeps the queue of jobs that the workers take from.
+struct job_queue {
+  mutex lock;
+  condition_variable ready;
+  deque<job> jobs;
+  bool closed = false;
+
+  // Function that puts a job at the end of the queue.
+  void push(job j) {
+    {
+      lock_guard<mutex> guard(lock);
+      jobs.push_back(move(j));
+    }
+    ready.notify_one();
+  }
+
+  // Function that takes the first job of the queue, waiting for one, and
+  // returns false once the queue is closed and empty.
+  bool pop(job& j) {
+    unique_lock<mutex> guard(lock);
+    ready.wait(guard, [&]() { return closed || !jobs.empty(); });
+    if (jobs.empty()) return false;
+    j = move(jobs.front());
+    jobs.pop_front();
+    return true;
+  }
+
+  // Function that closes the queue once the jobs left are taken.
+  void close() {
+    {
+      lock_guard<mutex> guard(lock);
+      closed = true;
+    }
+    ready.notify_all();
+  }
+};
+
+// Data structure that keeps the buffers of a worker, which are reused from
+// one job to the next: the instance, the state of the tabu search with its
+// solution, used cars and gains of the neighbors, the buffers of the
+// evaluator and the text of the answer.
+struct worker_buffers {
+  instance inst;
+  tabu_state tabu;
+  sequence_scratch scratch;
+  string answer;
+};
+
+// Data structure that keeps the options of the jobs given to the service,
+// which a request can change for its job: the way to solve it ('--mode',
+// 'tabu' or 'greedy'), the seed, the iterations, the time budget in seconds
+// and the stall, tenure and radius of the tabu search.
+struct job_options {
+  string mode = "tabu";
+  unsigned seed = 1;
+  long iterations = 2000, stall = 500;
+  double limit = 0;
+  int tenure = 10, radius = 1000;
+};
+
+// Function that reads the options of a request with the words 'words', with
+// the options of the service as default.
+job_options read_options(const vector<string>& words, const job_options& base) {
+  vector<char*> argv;
+  for (int w = 0; w < int(words.size()); ++w) argv.push_back(const_cast<char*>(words[w].c_str()));
+  int argc = argv.size();
+  job_options options;
+  options.mode = get_option(argc, argv.data(), "--mode", base.mode);
+  options.seed = get_option(argc, argv.data(), "--seed", base.seed);
+  options.iterations = get_option(argc, argv.data(), "--iterations", base.iterations);
+  options.limit = get_option(argc, argv.data(), "--time-limit", base.limit);
+  options.stall = get_option(argc, argv.data(), "--stall", base.stall);
+  options.tenure = get_option(argc, argv.data(), "--tenure", base.tenure);
+  options.radius = get_option(argc, argv.data(), "--radius", base.radius);
+  return options;
+}
+
+// Function that appends a time in seconds 'seconds' with a precision of a
+// microsecond to a text 'out'.
+void append_seconds(string& out, double seconds) {
+  char text[32];
+  out.append(text, snprintf(text, sizeof(text), "%.6f", seconds));
+}
+
+// We count the jobs answered and add up their times, to report them at the end.
+atomic<long long> answered(0);
+mutex totals_lock;
+double total_wait = 0, total_solve = 0;
+
+// Function that solves a job with the buffers 'b' of a worker and answers it
+// in a line 'job <id> penalty <p> wait <s> parse <s> solve <s> sequence ...',
+// or 'job <id> error <message>' if its instance is not valid.
+void solve_job(const job& j, worker_buffers& b, const job_options& base) {
+  wall_clock::time_point start = wall_clock::now();
+  double wait = chrono::duration<double>(start - j.queued).count();
+  job_options options = read_options(j.words, base);
+  b.answer = "job ";
+  b.answer += to_string(j.id);
+
+  // We read the instance from its file or from the request.
+  string error;
+  bool ok = j.path.empty() ? parse_instance(j.text.data(), j.text.size(), b.inst, error)
+      : load_instance(j.path, b.inst, error);
+  if (ok && options.mode != "tabu" && options.mode != "greedy") {
+    error = "unknown mode " + options.mode;
+    ok = false;
+  }
+  if (!ok) {
+    b.answer += " error " + error + "\n";
+    j.client->answer(b.answer);
+    return;
+  }
+  double parse = seconds_since(start);
+
+  // We solve it with the greedy algorithm or the tabu search, which starts
+  // from it, in the buffers of the worker.
+  wall_clock::time_point solving = wall_clock::now();
+  const vector<int>* solution;
+  int penalty;
+  if (options.mode == "greedy") {
+    b.tabu.start.assign(b.inst.cars, 0);
+    b.tabu.used.assign(b.inst.classes, 0);
+    constructive(b.tabu.start, b.tabu.used, b.inst);
+    solution = &b.tabu.start;
+    penalty = sequence_penalty(b.tabu.start, b.inst, b.scratch);
+  }
+  else {
+    time_budget budget;
+    budget.start = solving;
+    budget.limit = options.limit;
+    tabu_search(b.tabu, b.inst, options.seed, options.iterations, options.stall,
+        options.tenure, options.radius, budget, []() {});
+    solution = &b.tabu.best;
+    penalty = b.tabu.best_penalty;
+  }
+  double solve = seconds_since(solving);
+
+  // We answer the penalty, the times and the sequence in a single write.
+  b.answer += " penalty ";
+  append_int(b.answer, penalty);
+  b.answer += " wait ";
+  append_seconds(b.answer, wait);
+  b.answer += " parse ";
+  append_seconds(b.answer, parse);
+  b.answer += " solve ";
+  append_seconds(b.answer, solve);
+  b.answer += " sequence";
+  for (int p = 0; p < int(solution->size()); ++p) {
+    b.answer.push_back(' ');
+    append_int(b.answer, (*solution)[p]);
+  }
+  b.answer.push_back('\n');
+  j.client->answer(b.answer);
+
+  ++answered;
+  lock_guard<mutex> guard(totals_lock);
+  total_wait += wait;
+  total_solve += solve;
+}
+
+// Function that runs a worker, which solves the jobs of the queue until it
+// is closed.
+void worker(job_queue& queue, const job_options& base) {
+  worker_buffers b;
+  job j;
+  while (queue.pop(j)) {
+    solve_job(j, b, base);
+    j = job();
+  }
+}
+
+// Data structure that reads the lines of a descriptor in chunks of a fixed
+// buffer.
+struct line_reader {
+  int fd;
+  char buffer[1 << 16];
+  int begin = 0, end = 0;
+
+  // Function that reads the next line into 'line' and returns whether there
+  // was one.
+  bool next(string& line) {
+    line.clear();
+    while (true) {
+      if (begin == end) {
+        ssize_t size;
+        do size = read(fd, buffer, sizeof(buffer)); while (size < 0 && errno == EINTR);
+        if (size <= 0) return !line.empty();
+        begin = 0;
+        end = size;
+      }
+      char* start = buffer + begin;
+      char* newline = static_cast<char*>(memchr(start, '\n', end - begin));
+      if (newline == NULL) {
+        line.append(start, end - begin);
+        begin = end;
+        continue;
+      }
+      line.append(start, newline - start);
+      begin = newline - buffer + 1;
+      return true;
+    }
+  }
+};
+
+// Function that reads the requests of a client and queues their jobs. A
+// request is a line 'solve <path> [options]', or a line 'inline [options]'
+// followed by the lines of an instance and a line 'end'. The jobs of the
+// client are numbered from one in the order of their requests.
+void serve(shared_ptr<connection> client, job_queue& queue) {
+  line_reader in;
+  in.fd = client->in;
+  long long id = 0;
+  string line;
+  while (in.next(line)) {
+    job j;
+    j.client = client;
+    stringstream words(line);
+    for (string word; words >> word; ) j.words.push_back(word);
+    if (j.words.empty()) continue;
+    j.id = ++id;
+    if (j.words[0] == "solve" && j.words.size() >= 2) j.path = j.words[1];
+    else if (j.words[0] == "inline") {
+      while (in.next(line) && line != "end") {
+        j.text += line;
+        j.text.push_back('\n');
+      }
+    }
+    else {
+      client->answer("job " + to_string(j.id) + " error bad request\n");
+      continue;
+    }
+    j.queued = wall_clock::now();
+    queue.push(move(j));
+  }
+}
+
+int main(int argc, char** argv) {
+  // We read the number of workers ('--threads', one per core by default),
+  // the Unix socket to listen to ('--socket', the standard input and output
+  // if it is not given) and the options of the jobs, which a request can
+  // change: '--mode', '--seed', '--iterations', '--time-limit', '--stall',
+  // '--tenure' and '--radius'.
+  int threads = get_option(argc, argv, "--threads", 0);
+  if (threads <= 0) threads = max(1u, thread::hardware_concurrency());
+  string socket_path = get_option(argc, argv, "--socket", string());
+  vector<string> words(argv, argv + argc);
+  job_options base = read_options(words, job_options());
+  base.seed = get_option(argc, argv, "--seed", (unsigned) time(NULL));
+  signal(SIGPIPE, SIG_IGN);
+
+  // We start the workers.
+  wall_clock::time_point start = wall_clock::now();
+  job_queue queue;
+  vector<thread> pool;
+  for (int t = 0; t < threads; ++t) pool.push_back(thread(worker, ref(queue), cref(base)));
+
+  // Without a socket, we serve the standard input until it ends and wait
+  // for the jobs left.
+  if (socket_path.empty()) {
+    serve(make_shared<connection>(0, 1, false), queue);
+    queue.close();
+    for (int t = 0; t < threads; ++t) pool[t].join();
+    double seconds = seconds_since(start);
+    long long jobs = answered;
+    cerr << jobs << " jobs solved in " << seconds << " s, mean wait "
+        << total_wait / max(1LL, jobs) << " s, mean solve " << total_solve / max(1LL, jobs)
+        << " s" << endl;
+    return 0;
+  }
+
+  // Otherwise we listen to the socket and serve every client in a thread
+  // of its own, until the service is stopped.
+  int server = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (server < 0 || socket_path.size() >= sizeof(address.sun_path)) {
+    cerr << "cannot listen to " << socket_path << endl;
+    return 1;
+  }
+  strcpy(address.sun_path, socket_path.c_str());
+  unlink(socket_path.c_str());
+  if (bind(server, (sockaddr*) &address, sizeof(address)) < 0 || listen(server, 64) < 0) {
+    cerr << "cannot listen to " << socket_path << endl;
+    return 1;
+  }
+  while (true) {
+    int client = accept(server, NULL, NULL);
+    if (client < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    thread(serve, make_shared<connection>(client, client, true), ref(queue)).detach();
+  }
+  queue.close();
+  for (int t = 0; t < threads; ++t) pool[t].join();
+}
@@ -0,0 +1,253 @@
+/*
+  ________________________
+ /\                       \
+ \_|  STREAMING SEQUENCER |
+   |                      |
+   |       stream.cc      |
+   |   ___________________|_
+    \_/_____________________/
+*/
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <math.h>
+#include <unistd.h>
+#include "instance.h"
+#include "penalty.h"
+using namespace std;
+
+// Data structure that reads the integers of a stream in chunks of a fixed
+// buffer, so that a stream of any length is read in constant memory. The
+// output is flushed before waiting for more input, so the cars committed
+// so far are seen at once when the orders arrive slowly.
+struct stream_reader {
+  int fd;
+  char buffer[1 << 16];
+  int begin = 0, end = 0;
+
+  // Function that returns the next character, or -1 at the end.
+  int get() {
+    if (begin == end) {
+      fflush(stdout);
+      ssize_t size;
+      do size = read(fd, buffer, sizeof(buffer)); while (size < 0 && errno == EINTR);
+      if (size <= 0) return -1;
+      begin = 0;
+      end = size;
+    }
+    return (unsigned char) buffer[begin++];
+  }
+
+  // Function that reads the next non-negative integer into 'value' and
+  // returns 1 if there was one, 0 at the end of the stream and -1 if the
+  // stream has something else.
+  int next(int& value) {
+    int c = get();
+    while (c == ' ' || c == '\n' || c == '\t' || c == '\r') c = get();
+    if (c < 0) return 0;
+    if (c < '0' || c > '9') return -1;
+    long long number = 0;
+    for (; c >= '0' && c <= '9'; c = get()) {
+      number = number * 10 + (c - '0');
+      if (number > INT_MAX) return -1;
+    }
+    value = int(number);
+    return 1;
+  }
+};
+
+// Data structure that keeps the state of the stream: the cars waiting in the
+// lookahead buffer in order of arrival with the number of cars committed when
+// they arrived, how many cars of every class and needing every station wait,
+// the last 'reach' cars committed and, for every station, the upgrades of the
+// last 'ne' - 1 of them.
+struct stream_state {
+  int lookahead, reach = 1;
+  vector<int> buffer;
+  vector<long long> arrival;
+  int size = 0;
+  vector<int> waiting, demand;
+  vector<int> history;
+  vector<int> window;
+  long long committed = 0, penalty = 0;
+};
+
+// Function that sets up the state of a stream with a buffer of 'lookahead' cars.
+void init_stream(stream_state& st, const instance& inst, int lookahead) {
+  st.lookahead = lookahead;
+  st.buffer.assign(lookahead, 0);
+  st.arrival.assign(lookahead, 0);
+  st.waiting.assign(inst.classes, 0);
+  st.demand.assign(inst.improvements, 0);
+  st.window.assign(inst.improvements, 0);
+  for (int s = 0; s < inst.improvements; ++s)
+    st.reach = max(st.reach, inst.resources[s].second);
+  st.history.assign(st.reach, 0);
+}
+
+// Function that puts a car of a class 'c' that has arrived at the end of
+// the buffer.
+void push_car(stream_state& st, const instance& inst, int c) {
+  st.buffer[st.size] = c;
+  st.arrival[st.size] = st.committed;
+  ++st.size;
+  ++st.waiting[c];
+  for (int s = 0; s < inst.improvements; ++s)
+    if (inst.has(c, s)) ++st.demand[s];
+}
+
+// Function that chooses the class of the next car to commit: the class in
+// the buffer that adds the least excess to the windows that end at the next
+// index, breaking ties by the most critical stations as the constructive
+// greedy does, but over the cars in the buffer. If the first car of the
+// buffer has waited 'max_wait' cars, it goes first.
+int choose_class(const stream_state& st, const instance& inst, long long max_wait) {
+  if (st.committed - st.arrival[0] >= max_wait) return st.buffer[0];
+  int best = -1, best_excess = 0;
+  double best_criticality = 0;
+  for (int c = 0; c < inst.classes; ++c) {
+    if (st.waiting[c] == 0) continue;
+    int added = 0;
+    double critical = 0;
+    const uint64_t* mask = inst.mask(c);
+    for (int w = 0; w < inst.mask_words; ++w)
+      for (uint64_t bits = mask[w]; bits; bits &= bits - 1) {
+        int s = w * 64 + __builtin_ctzll(bits);
+        added += (st.window[s] >= inst.resources[s].first);
+        double capacity = double(inst.resources[s].first) * st.lookahead / inst.resources[s].second;
+        critical += st.demand[s] / max(capacity, 1.0);
+      }
+    if (best < 0 || added < best_excess
+        || (added == best_excess && critical > best_criticality)) {
+      best = c;
+      best_excess = added;
+      best_criticality = critical;
+    }
+  }
+  return best;
+}
+
+// Function that commits the first car of a class 'c' in the buffer: it adds
+// the excess of the windows that end at its index to the penalty and slides
+// the counters of the stations.
+void commit_car(stream_state& st, const instance& inst, int c) {
+  int at = 0;
+  while (st.buffer[at] != c) ++at;
+  for (int i = at; i + 1 < st.size; ++i) {
+    st.buffer[i] = st.buffer[i + 1];
+    st.arrival[i] = st.arrival[i + 1];
+  }
+  --st.size;
+  --st.waiting[c];
+
+  // We keep the car in the history first, as it is the one that leaves the
+  // window of the next index when the window has a single car.
+  long long k = st.committed;
+  st.history[k % st.reach] = c;
+  for (int s = 0; s < inst.improvements; ++s) {
+    int window = inst.resources[s].second;
+    if (inst.has(c, s)) { ++st.window[s]; --st.demand[s]; }
+    st.penalty += excess(st.window[s], inst.resources[s].first);
+    // We take out the car that leaves the window of the next index.
+    if (k - window + 1 >= 0 && inst.has(st.history[(k - window + 1) % st.reach], s)) --st.window[s];
+  }
+  ++st.committed;
+}
+
+// Function that adds the excess of the incomplete windows at the end of the
+// stream, so that the penalty is the same as the one of the whole sequence.
+void finish_stream(stream_state& st, const instance& inst) {
+  long long n = st.committed;
+  for (int s = 0; s < inst.improvements; ++s) {
+    int num_upgrades = 0;
+    long long first = max(0LL, n - inst.resources[s].second + 1);
+    for (long long t = n - 1; t >= first; --t) {
+      num_upgrades += inst.has(st.history[t % st.reach], s);
+      if (t < n - 1) st.penalty += excess(num_upgrades, inst.resources[s].first);
+    }
+  }
+}
+
+// Data structure that keeps the histogram of the latencies of the decisions
+// in constant memory: 'SUBBUCKETS' buckets for every power of two of
+// nanoseconds, so a percentile is read within about 5%.
+struct latency_histogram {
+  static const int SUBBUCKETS = 16;
+  static const int BUCKETS = 48 * SUBBUCKETS;
+  long long counts[BUCKETS] = {};
+  long long total = 0;
+  double max_ns = 0;
+
+  // Function that counts a latency of 'ns' nanoseconds.
+  void add(double ns) {
+    int b = (ns < 1) ? 0 : min(BUCKETS - 1, int(log2(ns) * SUBBUCKETS));
+    ++counts[b];
+    ++total;
+    max_ns = max(max_ns, ns);
+  }
+
+  // Function that returns the latency under which a share 'q' of the
+  // decisions fall, in nanoseconds.
+  double percentile(double q) const {
+    long long rank = (long long) ceil(q * total), seen = 0;
+    for (int b = 0; b < BUCKETS; ++b)
+      if ((seen += counts[b]) >= rank && seen > 0) return min(max_ns, exp2(double(b + 1) / SUBBUCKETS));
+    return max_ns;
+  }
+};
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    cerr << "Syntax is: " << argv[0] << " instance [--lookahead L] [--max-wait W] < orders" << endl;
+    return 1;
+  }
+  // We read the stations and the classes of the line from an instance, whose
+  // numbers of cars are not used. We read the size of the lookahead buffer
+  // ('--lookahead', 32 cars by default) and how many cars a car can wait in
+  // it before it goes first ('--max-wait', twice the buffer by default).
+  instance inst = read_instance(argv[1]);
+  int lookahead = max(1, get_option(argc, argv, "--lookahead", 32));
+  long long max_wait = get_option(argc, argv, "--max-wait", 2LL * lookahead);
+
+  // We read the classes of the cars from the standard input as they arrive,
+  // and commit a car every time the buffer is full and at the end, writing
+  // every car committed in a line of the standard output.
+  stream_state st;
+  init_stream(st, inst, lookahead);
+  static stream_reader in;
+  in.fd = 0;
+  latency_histogram latency;
+  static char output[1 << 16];
+  setvbuf(stdout, output, _IOFBF, sizeof(output));
+  for (bool open = true; open || st.size > 0; ) {
+    if (open && st.size < lookahead) {
+      int c, status = in.next(c);
+      if (status > 0 && c >= inst.classes) status = -1;
+      if (status < 0) {
+        fflush(stdout);
+        cerr << "bad car order after " << st.committed + st.size << " cars" << endl;
+        return 1;
+      }
+      if (status == 0) open = false;
+      else push_car(st, inst, c);
+      continue;
+    }
+    wall_clock::time_point start = wall_clock::now();
+    int c = choose_class(st, inst, max_wait);
+    commit_car(st, inst, c);
+    latency.add(std::chrono::duration<double, std::nano>(wall_clock::now() - start).count());
+    printf("%d\n", c);
+  }
+  finish_stream(st, inst);
+  fflush(stdout);
+
+  // We report the penalty of the sequence committed and the percentiles of
+  // the time taken by every decision.
+  fprintf(stderr, "%lld cars, penalty %lld, decision latency p50 %.0f ns, p90 %.0f ns,"
+      " p99 %.0f ns, p99.9 %.0f ns, max %.0f ns\n", st.committed, st.penalty,
+      latency.percentile(0.5), latency.percentile(0.9), latency.percentile(0.99),
+      latency.percentile(0.999), latency.max_ns);
+}
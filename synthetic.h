@@ -0,0 +1,125 @@
+/*
+  ________________________
+ /\                       \
+ \_| SYNTHETIC INSTANCES  |
+   |                      |
+   |      synthetic.h     |
+   |   ___________________|_
+    \_/_____________________/
+*/
+#ifndef SYNTHETIC_H
+#define SYNTHETIC_H
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include "instance.h"
+
+// Data structure that sets the shape of a generated instance: the number of
+// cars, stations and classes, the range of the windows of the stations, the
+// utilization 'ce' / 'ne' of every station (drawn at random if zero) and the
+// load, which is the share of the capacity of every station that the cars
+// need on average.
+struct instance_shape {
+  int cars = 100, improvements = 5, classes = 10;
+  int min_window = 2, max_window = 33;
+  double utilization = 0;
+  double load = 0.9;
+};
+
+// Function that generates an instance of a shape 'shape'. Every station gets
+// a window and a capacity of the utilization of its window (at least one),
+// and every class needs it with the probability that makes the cars need the
+// load of its capacity. The cars are split at random among the classes, with
+// at least one each when there are enough.
+inline instance generate_instance(const instance_shape& shape, std::mt19937& rng) {
+  instance inst;
+  inst.cars = shape.cars; inst.improvements = shape.improvements; inst.classes = shape.classes;
+
+  // We pick a window 'ne' and a capacity 'ce' below it for every station.
+  inst.resources.resize(inst.improvements);
+  std::vector<double> share(inst.improvements);
+  int min_window = std::max(1, shape.min_window);
+  int max_window = std::max(min_window, shape.max_window);
+  for (int s = 0; s < inst.improvements; ++s) {
+    int window = std::uniform_int_distribution<int>(min_window, max_window)(rng);
+    double utilization = (shape.utilization > 0) ? shape.utilization
+        : std::uniform_real_distribution<double>(0.1, 0.9)(rng);
+    int capacity = std::max(1, std::min(window, int(utilization * window + 0.5)));
+    inst.resources[s] = {capacity, window};
+    share[s] = std::min(1.0, shape.load * capacity / window);
+  }
+
+  // We split the cars among the classes, cutting them at random points.
+  inst.models.resize(inst.classes);
+  std::vector<int> cuts;
+  int spare = inst.cars - std::min(inst.cars, inst.classes);
+  for (int c = 0; c + 1 < inst.classes; ++c)
+    cuts.push_back(std::uniform_int_distribution<int>(0, spare)(rng));
+  cuts.push_back(spare);
+  std::sort(cuts.begin(), cuts.end());
+  for (int c = 0, last = 0; c < inst.classes; ++c) {
+    inst.models[c].model = c;
+    inst.models[c].num_cars = cuts[c] - last + (c < inst.cars);
+    last = cuts[c];
+  }
+
+  // We pick the upgrades of every class.
+  inst.mask_words = (inst.improvements + 63) / 64;
+  inst.masks.assign(inst.classes * inst.mask_words, 0);
+  for (int c = 0; c < inst.classes; ++c)
+    for (int s = 0; s < inst.improvements; ++s)
+      if (std::bernoulli_distribution(share[s])(rng)) {
+        ++inst.models[c].num_upgrades;
+        inst.masks[c * inst.mask_words + (s >> 6)] |= uint64_t(1) << (s & 63);
+      }
+  return inst;
+}
+
+// Function that returns a random sequence with the cars of an instance.
+inline std::vector<int> random_sequence(const instance& inst, std::mt19937& rng) {
+  std::vector<int> solution;
+  for (int c = 0; c < inst.classes; ++c)
+    solution.insert(solution.end(), inst.models[c].num_cars, c);
+  std::shuffle(solution.begin(), solution.end(), rng);
+  return solution;
+}
+
+// Function that formats an instance as it is written in the input files.
+inline std::string format_instance(const instance& inst) {
+  std::string out;
+  append_int(out, inst.cars); out.push_back(' ');
+  append_int(out, inst.improvements); out.push_back(' ');
+  append_int(out, inst.classes); out.push_back('\n');
+  for (int s = 0; s < inst.improvements; ++s) {
+    append_int(out, inst.resources[s].first);
+    out.push_back(s + 1 < inst.improvements ? ' ' : '\n');
+  }
+  for (int s = 0; s < inst.improvements; ++s) {
+    append_int(out, inst.resources[s].second);
+    out.push_back(s + 1 < inst.improvements ? ' ' : '\n');
+  }
+  for (int c = 0; c < inst.classes; ++c) {
+    append_int(out, c); out.push_back(' ');
+    append_int(out, inst.models[c].num_cars);
+    for (int s = 0; s < inst.improvements; ++s) {
+      out.push_back(' ');
+      out.push_back(inst.has(c, s) ? '1' : '0');
+    }
+    out.push_back('\n');
+  }
+  return out;
+}
+
+// Function that writes an instance in a file 'path'.
+inline bool write_instance(const instance& inst, const std::string& path) {
+  std::string text = format_instance(inst);
+  FILE* out = fopen(path.c_str(), "wb");
+  if (!out) return false;
+  bool ok = fwrite(text.data(), 1, text.size(), out) == text.size();
+  return (fclose(out) == 0) && ok;
+}
+
+#endif
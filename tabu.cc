@@ -0,0 +1,53 @@
+/*
+  ________________________
+ /\                       \
+ \_|      TABU SEARCH     |
+   |                      |
+   |        tabu.cc       |
+   |   ___________________|_
+    \_/_____________________/
+*/
+#include <iostream>
+#include <vector>
+#include <time.h>
+#include "instance.h"
+#include "penalty.h"
+#include "writer.h"
+#include "tabu.h"
+using namespace std;
+
+int main(int argc, char** argv) {
+  // We read the instance of the problem.
+  instance inst = read_instance(argv[1]);
+  // We read the seed of the random number generator ('--seed'), the number
+  // of iterations ('--iterations'), the iterations without improvement
+  // before a kick ('--stall', 0 to never do it), the tabu tenure ('--tenure')
+  // and how far apart the swapped cars can be ('--radius').
+  unsigned seed = get_option(argc, argv, "--seed", (unsigned) time(NULL));
+  long iterations = get_option(argc, argv, "--iterations", 20000L);
+  long stall = get_option(argc, argv, "--stall", 500L);
+  int tenure = get_option(argc, argv, "--tenure", 10);
+  int radius = get_option(argc, argv, "--radius", 1000);
+
+  // We get the current time before executing the tabu search and read its
+  // time budget in seconds ('--time-limit'), which replaces the number of
+  // iterations.
+  wall_clock::time_point time;
+  time = wall_clock::now();
+  time_budget budget = read_budget(argc, argv, time);
+
+  // We find a solution by following the tabu search. The best solutions
+  // are written in the background as they are found.
+  long long scored = 0;
+  {
+    solution_writer out(argv[2], time);
+    tabu_state t;
+    scored = tabu_search(t, inst, seed, iterations, stall, tenure, radius, budget,
+        [&]() { out.post(t.best_penalty, t.best); });
+  }
+
+  // We report the swaps scored and how many were scored every second.
+  double seconds = seconds_since(time);
+  cerr << "evaluated " << scored << " moves in " << seconds << " s, "
+      << (long long) (scored / max(seconds, 1e-9)) << " moves/s" << endl;
+}
@@ -0,0 +1,252 @@
+/*
+  ________________________
+ /\                       \
+ \_|      TABU SEARCH     |
+   |                      |
+   |        tabu.h        |
+   |   ___________________|_
+    \_/_____________________/
+*/
+#ifndef TABU_H
+#define TABU_H
+
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <climits>
+#include <stdint.h>
+#include "instance.h"
+#include "penalty.h"
+#include "constructive.h"
+
+// Data structure that keeps the state of the tabu search: the solution with
+// its window table and its penalty and, for every station, the prefix sums
+// over its windows (in the order of the table) of the ones with at least,
+// over and exactly 'ce' upgrades. 'gain' keeps, for every index 'p' and
+// class 'c', the change of penalty of putting a car of 'c' at 'p' alone, so
+// that the change of a swap is the sum of two entries minus the windows that
+// hold both indexes. 'tabu' keeps, for every index and class, the iteration
+// until which the class cannot be put back at the index. 'reach' is the
+// largest window and 'tail_first' the first index of an incomplete window
+// at the end. The state also keeps the best solution found and the buffers
+// of the greedy start, so that a state used for many instances reuses them.
+struct tabu_state {
+  std::vector<int> solution, best, start, used;
+  int best_penalty = INT_MAX;
+  window_table table;
+  int penalty;
+  std::vector<std::vector<int>> at_least, over, at;
+  std::vector<int> gain;
+  std::vector<long> tabu;
+  int reach = 1, tail_first = 0;
+};
+
+// Function that rebuilds the prefix sums of the windows of a station 's'.
+inline void rebuild_station(tabu_state& t, const instance& inst, int s) {
+  const std::vector<int>& counts = t.table.counts[s];
+  int capacity = inst.resources[s].first, size = counts.size();
+  std::vector<int>& at_least = t.at_least[s];
+  std::vector<int>& over = t.over[s];
+  std::vector<int>& at = t.at[s];
+  at_least.assign(size + 1, 0);
+  over.assign(size + 1, 0);
+  at.assign(size + 1, 0);
+  for (int w = 0; w < size; ++w) {
+    at_least[w + 1] = at_least[w] + (counts[w] >= capacity);
+    over[w + 1] = over[w] + (counts[w] > capacity);
+    at[w + 1] = at[w] + (counts[w] == capacity);
+  }
+}
+
+// Function that sums the prefix sums 'prefix' of a station with a window
+// 'window' over its windows that hold all the indexes from 'i' to 'j'.
+inline int windows_holding(const std::vector<int>& prefix, int n, int window, int i, int j) {
+  int sum = 0;
+  // We sum the windows that end at an index from 'j' to 'i' + 'ne' - 1.
+  int lo = j, hi = std::min(i + window - 1, n - 1);
+  if (lo <= hi) sum += prefix[hi + 1] - prefix[lo];
+  // We sum the incomplete windows at the end that start before 'i'.
+  int first = tail_start(n, window);
+  hi = std::min(i, n - 2);
+  if (first <= hi) sum += prefix[n + hi - first + 1] - prefix[n];
+  return sum;
+}
+
+// Function that computes the change of penalty of putting a car of a class
+// 'c' at the index 'p' alone. An upgrade more adds one to the windows with
+// at least 'ce' upgrades and an upgrade less takes one from the ones over it.
+inline int position_gain(const tabu_state& t, const instance& inst, int p, int c) {
+  int n = t.solution.size(), delta = 0;
+  const uint64_t* from = inst.mask(t.solution[p]);
+  const uint64_t* to = inst.mask(c);
+  for (int w = 0; w < inst.mask_words; ++w)
+    for (uint64_t diff = from[w] ^ to[w]; diff; diff &= diff - 1) {
+      int s = w * 64 + __builtin_ctzll(diff);
+      int window = inst.resources[s].second;
+      if (inst.has(c, s)) delta += windows_holding(t.at_least[s], n, window, p, p);
+      else delta -= windows_holding(t.over[s], n, window, p, p);
+    }
+  return delta;
+}
+
+// Function that computes the change of penalty of swapping the indexes 'i'
+// and 'j' (i < j) from the table of gains. The windows that hold both
+// indexes do not change, but the gains count them once with an upgrade
+// more and once with an upgrade less, which only adds up to one when they
+// have exactly 'ce' upgrades, so we take those away if there can be any.
+inline int swap_gain(const tabu_state& t, const instance& inst, int i, int j) {
+  int n = t.solution.size(), classes = inst.classes;
+  int a = t.solution[i], b = t.solution[j];
+  int delta = t.gain[i * classes + b] + t.gain[j * classes + a];
+  if (j - i >= t.reach && i < t.tail_first) return delta;
+  const uint64_t* mask_a = inst.mask(a);
+  const uint64_t* mask_b = inst.mask(b);
+  for (int w = 0; w < inst.mask_words; ++w)
+    for (uint64_t diff = mask_a[w] ^ mask_b[w]; diff; diff &= diff - 1) {
+      int s = w * 64 + __builtin_ctzll(diff);
+      delta -= windows_holding(t.at[s], n, inst.resources[s].second, i, j);
+    }
+  return delta;
+}
+
+// Function that rebuilds the window table, the prefix sums and the gains
+// of the solution of the search.
+inline void rebuild(tabu_state& t, const instance& inst) {
+  int n = t.solution.size(), classes = inst.classes;
+  t.penalty = build_windows(t.solution, t.table, inst);
+  for (int s = 0; s < inst.improvements; ++s) rebuild_station(t, inst, s);
+  for (int p = 0; p < n; ++p)
+    for (int c = 0; c < classes; ++c) t.gain[p * classes + c] = position_gain(t, inst, p, c);
+}
+
+// Function that sets up the search from a solution 'solution'.
+inline void init_state(tabu_state& t, const instance& inst, const std::vector<int>& solution) {
+  int n = solution.size();
+  t.solution = solution;
+  t.at_least.resize(inst.improvements);
+  t.over.resize(inst.improvements);
+  t.at.resize(inst.improvements);
+  t.gain.assign(n * inst.classes, 0);
+  t.tabu.assign(n * inst.classes, 0);
+  t.reach = 1;
+  for (int s = 0; s < inst.improvements; ++s)
+    t.reach = std::max(t.reach, inst.resources[s].second);
+  t.tail_first = std::max(0, n - t.reach + 1);
+  rebuild(t, inst);
+}
+
+// Function that swaps the indexes 'i' and 'j' of the solution and updates
+// the table of gains. Only the stations where the two classes differ
+// change, and only the indexes that share a window with 'i' or 'j' see
+// their gains change.
+inline void apply_swap(tabu_state& t, const instance& inst, int i, int j) {
+  int n = t.solution.size(), classes = inst.classes;
+  int a = t.solution[i], b = t.solution[j];
+  t.penalty += swap_delta(t.solution, i, j, t.table, inst, true);
+  std::swap(t.solution[i], t.solution[j]);
+  const uint64_t* mask_a = inst.mask(a);
+  const uint64_t* mask_b = inst.mask(b);
+  for (int w = 0; w < inst.mask_words; ++w)
+    for (uint64_t diff = mask_a[w] ^ mask_b[w]; diff; diff &= diff - 1)
+      rebuild_station(t, inst, w * 64 + __builtin_ctzll(diff));
+
+  // We update the gains of the indexes around 'i' and around 'j'.
+  int last = -1;
+  for (int k = 0; k < 2; ++k) {
+    int center = (k == 0) ? i : j;
+    for (int p = std::max(last + 1, center - t.reach + 1); p <= std::min(n - 1, center + t.reach - 1); ++p)
+      for (int c = 0; c < classes; ++c) t.gain[p * classes + c] = position_gain(t, inst, p, c);
+    last = std::max(last, std::min(n - 1, center + t.reach - 1));
+  }
+}
+
+// Function that perturbs a solution with 'kicks' random shifts of a car
+// within the largest window.
+inline void kick(std::vector<int>& solution, int kicks, int reach, std::mt19937& rng) {
+  int n = solution.size();
+  std::uniform_int_distribution<int> index(0, n - 1), offset(1, std::max(1, reach));
+  for (int k = 0; k < kicks; ++k) {
+    int i = index(rng), j = std::max(0, std::min(n - 1, i + ((rng() & 1) ? 1 : -1) * offset(rng)));
+    if (i < j) std::rotate(solution.begin() + i, solution.begin() + i + 1, solution.begin() + j + 1);
+    else if (j < i) std::rotate(solution.begin() + j, solution.begin() + i, solution.begin() + i + 1);
+  }
+}
+
+// We define the share of the cars shifted by a kick.
+const int KICK_SHARE = 20;
+
+// Function that finds a solution by a tabu search over the swaps of two cars
+// of different classes within 'radius' indexes, started from the greedy
+// solution. Every iteration makes the best swap that is not tabu, unless it
+// leads to a better solution than the best one (aspiration), and forbids the
+// classes it takes away to come back to their indexes for 'tenure' to twice
+// 'tenure' iterations. When the best solution has not improved in 'stall'
+// iterations (never if 'stall' is not positive), or when every swap is tabu,
+// the search goes on from it after a kick of random shifts.
+// The best solution is kept in the state, and 'improved' is called every
+// time it changes. It returns the number of swaps scored. The clock is read
+// every iteration, as an iteration of a long sequence scores many swaps.
+template <typename F>
+long long tabu_search(tabu_state& t, const instance& inst, unsigned seed, long iterations,
+    long stall, int tenure, int radius, const time_budget& budget, F improved) {
+
+  // We set up the search from the greedy solution.
+  int n = inst.cars, classes = inst.classes;
+  t.start.assign(n, 0);
+  t.used.assign(classes, 0);
+  constructive(t.start, t.used, inst);
+  init_state(t, inst, t.start);
+  t.best = t.solution;
+  t.best_penalty = t.penalty;
+  improved();
+  if (n < 2) return 0;
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> extra(0, tenure);
+
+  long stalled = 0;
+  long long scored = 0;
+  for (long iteration = 0; t.best_penalty > 0; ++iteration) {
+    if (budget.limit > 0 ? budget.expired() : iteration >= iterations) break;
+
+    // We look for the best swap that is allowed, breaking ties at random.
+    int move_i = -1, move_j = -1, best_delta = INT_MAX, ties = 0;
+    for (int i = 0; i < n; ++i)
+      for (int j = i + 1, last = std::min(n - 1, i + radius); j <= last; ++j) {
+        int a = t.solution[i], b = t.solution[j];
+        if (a == b) continue;
+        int delta = swap_gain(t, inst, i, j);
+        ++scored;
+        if (delta > best_delta) continue;
+        bool forbidden = t.tabu[i * classes + b] > iteration || t.tabu[j * classes + a] > iteration;
+        if (forbidden && t.penalty + delta >= t.best_penalty) continue;
+        if (delta < best_delta) { best_delta = delta; ties = 0; }
+        if (std::uniform_int_distribution<int>(0, ties++)(rng) == 0) { move_i = i; move_j = j; }
+      }
+
+    // We make the swap and forbid the classes to come back.
+    if (move_i >= 0) {
+      int a = t.solution[move_i], b = t.solution[move_j];
+      apply_swap(t, inst, move_i, move_j);
+      t.tabu[move_i * classes + a] = iteration + tenure + extra(rng);
+      t.tabu[move_j * classes + b] = iteration + tenure + extra(rng);
+    }
+
+    // We keep the solution if it is the best one, and otherwise we go on
+    // from a kick of the best one if the search has stalled.
+    if (t.penalty < t.best_penalty) {
+      t.best = t.solution;
+      t.best_penalty = t.penalty;
+      improved();
+      stalled = 0;
+    }
+    else if (move_i < 0 || (stall > 0 && ++stalled >= stall)) {
+      t.solution = t.best;
+      kick(t.solution, std::max(2, n / KICK_SHARE), t.reach, rng);
+      rebuild(t, inst);
+      stalled = 0;
+    }
+  }
+  return scored;
+}
+
+#endif
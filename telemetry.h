@@ -0,0 +1,194 @@
+/*
+  ________________________
+ /\                       \
+ \_|  ANNEALING TELEMETRY |
+   |                      |
+   |      telemetry.h     |
+   |   ___________________|_
+    \_/_____________________/
+*/
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <stdint.h>
+#include <stdio.h>
+#include "instance.h"
+
+// The telemetry of the annealing loop is only built with '-DMH_TELEMETRY'.
+// A chain that is traced keeps a pointer to its trace, and the loop calls
+// the 'trace_' functions with it. Without the flag those functions do
+// nothing, so the compiler removes every call to them.
+#ifdef MH_TELEMETRY
+
+// Data structure that keeps a sample of the trace of an annealing: the time
+// and the moves so far, the temperature, the current and the best penalty,
+// and the share of accepted moves, the moves per second and the share of the
+// time spent scoring moves since the sample before.
+struct trace_sample {
+  double seconds;
+  int64_t moves;
+  double temperature;
+  int penalty, best;
+  double acceptance, moves_per_second, evaluation_share;
+};
+
+// Data structure that records the trace of an annealing in a file 'path' as
+// CSV. A sample is taken every 'SAMPLE_INTERVAL' moves and put in a ring
+// buffer without taking any lock, and a thread writes the samples of the
+// ring every 'FLUSH_INTERVAL' milliseconds, so the loop never waits for the
+// file. If the ring is full, the sample is dropped and counted. The time
+// spent scoring moves is only measured in one of every 'TIMED_INTERVAL'
+// moves, so the clock is rarely read in the loop. The samples are taken by
+// one thread at a time.
+class annealing_trace {
+ public:
+  static const int SAMPLE_INTERVAL = 4096;
+  static const int TIMED_INTERVAL = 16;
+  static const int CAPACITY = 1024;
+  static const int FLUSH_INTERVAL = 100;
+
+  annealing_trace() {}
+  annealing_trace(const annealing_trace&) = delete;
+  annealing_trace& operator=(const annealing_trace&) = delete;
+  ~annealing_trace() { close(); }
+
+  // Function that starts the trace in a file 'path' at a time 'time'.
+  void open(const std::string& path, wall_clock::time_point time) {
+    out = fopen(path.c_str(), "w");
+    if (!out) return;
+    fprintf(out, "seconds,moves,temperature,penalty,best,acceptance,"
+        "moves_per_second,evaluation_share\n");
+    start = last = time;
+    stop = false;
+    background = std::thread(&annealing_trace::run, this);
+  }
+
+  // Function that marks the start of the scoring of a move.
+  void start_evaluation() {
+    if (out && moves % TIMED_INTERVAL == 0) evaluation_start = wall_clock::now();
+  }
+
+  // Function that marks the end of the scoring of a move.
+  void end_evaluation() {
+    if (out && moves % TIMED_INTERVAL == 0)
+      evaluation += std::chrono::duration<double>(wall_clock::now() - evaluation_start).count();
+  }
+
+  // Function that counts an accepted move.
+  void accept() { ++accepted; }
+
+  // Function that counts a move at a temperature 'temp' that left the
+  // penalties 'penalty' and 'best', and takes a sample if it is time.
+  void step(long double temp, int penalty, int best) {
+    if (!out || ++moves % SAMPLE_INTERVAL != 0) return;
+    wall_clock::time_point now = wall_clock::now();
+    double elapsed = std::chrono::duration<double>(now - last).count();
+    int64_t next = head.load(std::memory_order_relaxed);
+    if (next - tail.load(std::memory_order_acquire) == CAPACITY) {
+      ++dropped;
+      accepted = 0;
+      evaluation = 0;
+      last = now;
+      return;
+    }
+    trace_sample& sample = ring[next % CAPACITY];
+    sample.seconds = std::chrono::duration<double>(now - start).count();
+    sample.moves = moves;
+    sample.temperature = temp;
+    sample.penalty = penalty;
+    sample.best = best;
+    sample.acceptance = double(accepted) / SAMPLE_INTERVAL;
+    sample.moves_per_second = SAMPLE_INTERVAL / elapsed;
+    sample.evaluation_share = evaluation * TIMED_INTERVAL / elapsed;
+    accepted = 0;
+    evaluation = 0;
+    last = now;
+    head.store(next + 1, std::memory_order_release);
+  }
+
+  // Function that stops the thread, writes the samples left and closes
+  // the file, reporting the samples dropped if there are any.
+  void close() {
+    if (!out) return;
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      stop = true;
+    }
+    wake.notify_one();
+    background.join();
+    flush();
+    if (dropped > 0) fprintf(stderr, "trace dropped %lld samples\n", (long long) dropped);
+    fclose(out);
+    out = NULL;
+  }
+
+ private:
+  // Function that writes the samples of the ring buffer taken so far.
+  void flush() {
+    int64_t first = tail.load(std::memory_order_relaxed);
+    int64_t end = head.load(std::memory_order_acquire);
+    for (int64_t s = first; s < end; ++s) {
+      const trace_sample& sample = ring[s % CAPACITY];
+      fprintf(out, "%.6f,%lld,%.6g,%d,%d,%.4f,%.0f,%.4f\n", sample.seconds,
+          (long long) sample.moves, sample.temperature, sample.penalty, sample.best,
+          sample.acceptance, sample.moves_per_second, sample.evaluation_share);
+    }
+    tail.store(end, std::memory_order_release);
+  }
+
+  // Function that runs the thread that writes the samples.
+  void run() {
+    std::unique_lock<std::mutex> guard(lock);
+    while (!stop) {
+      guard.unlock();
+      flush();
+      guard.lock();
+      wake.wait_for(guard, std::chrono::milliseconds(FLUSH_INTERVAL), [this]() { return stop; });
+    }
+  }
+
+  FILE* out = NULL;
+  wall_clock::time_point start, last, evaluation_start;
+  int64_t moves = 0, accepted = 0, dropped = 0;
+  double evaluation = 0;
+  trace_sample ring[CAPACITY];
+  std::atomic<int64_t> head{0}, tail{0};
+  std::mutex lock;
+  std::condition_variable wake;
+  bool stop = false;
+  std::thread background;
+};
+
+// Functions that call the trace of a chain, if it has one.
+inline void trace_start_evaluation(annealing_trace* trace) { if (trace) trace->start_evaluation(); }
+inline void trace_end_evaluation(annealing_trace* trace) { if (trace) trace->end_evaluation(); }
+inline void trace_accept(annealing_trace* trace) { if (trace) trace->accept(); }
+inline void trace_step(annealing_trace* trace, long double temp, int penalty, int best) {
+  if (trace) trace->step(temp, penalty, best);
+}
+
+#else
+
+// Data structure that stands for the trace of an annealing when the
+// telemetry is not built, which records nothing.
+class annealing_trace {
+ public:
+  void open(const std::string&, wall_clock::time_point) {}
+  void close() {}
+};
+
+// Functions that do nothing in place of the calls to the trace.
+inline void trace_start_evaluation(annealing_trace*) {}
+inline void trace_end_evaluation(annealing_trace*) {}
+inline void trace_accept(annealing_trace*) {}
+inline void trace_step(annealing_trace*, long double, int, int) {}
+
+#endif
+
+#endif
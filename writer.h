@@ -0,0 +1,97 @@
+/*
+  ________________________
+ /\                       \
+ \_|   SOLUTION WRITER    |
+   |                      |
+   |       writer.h       |
+   |   ___________________|_
+    \_/_____________________/
+*/
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "instance.h"
+
+// Data structure that writes the best solution of a solver in the background.
+// The solver posts a copy of every new best solution in a mailbox of a single
+// slot without taking any lock: a post replaces the solution that was still
+// waiting, so the intermediate ones are never written. A thread takes the
+// last one from the slot at most every 'interval' and writes it, and the
+// destructor writes the solution left in the slot before returning.
+class solution_writer {
+ public:
+  solution_writer(const std::string& path, wall_clock::time_point time,
+      std::chrono::milliseconds interval = std::chrono::milliseconds(100))
+    : path(path), time(time), interval(interval), slot(nullptr), spare(nullptr),
+      stop(false), background(&solution_writer::run, this) {}
+
+  ~solution_writer() {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      stop = true;
+    }
+    wake.notify_one();
+    background.join();
+    // We write the last solution posted and free the buffers.
+    write_pending();
+    delete spare.exchange(nullptr);
+  }
+
+  // Function that posts a new best solution with a penalty 'penalty'.
+  void post(int penalty, const std::vector<int>& solution) {
+    // We reuse the buffer of a solution already written, if there is one.
+    snapshot* next = spare.exchange(nullptr);
+    if (next == nullptr) next = new snapshot;
+    next->penalty = penalty;
+    next->seconds = seconds_since(time);
+    next->solution = solution;
+    // We put it in the slot, dropping the solution that was waiting there.
+    delete slot.exchange(next);
+  }
+
+ private:
+  // Data structure that keeps a copy of a solution and the time to get it.
+  struct snapshot {
+    int penalty;
+    double seconds;
+    std::vector<int> solution;
+  };
+
+  // Function that writes the solution in the slot, if there is one.
+  void write_pending() {
+    snapshot* last = slot.exchange(nullptr);
+    if (last == nullptr) return;
+    write_solution(last->penalty, last->seconds, last->solution, path);
+    // We keep its buffer for the next post.
+    delete spare.exchange(last);
+  }
+
+  // Function that runs the thread that writes the solutions.
+  void run() {
+    std::unique_lock<std::mutex> guard(lock);
+    while (!stop) {
+      guard.unlock();
+      write_pending();
+      guard.lock();
+      wake.wait_for(guard, interval, [this]() { return stop; });
+    }
+  }
+
+  std::string path;
+  wall_clock::time_point time;
+  std::chrono::milliseconds interval;
+  std::atomic<snapshot*> slot, spare;
+  std::mutex lock;
+  std::condition_variable wake;
+  bool stop;
+  std::thread background;
+};
+
+#endif